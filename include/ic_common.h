@@ -1,7 +1,19 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
+#include <string_view>
 
 namespace IC {
     template <class Ret, class... Args> using Func = std::function<Ret(Args...)>;
-}
+
+    // FNV-1a, stable across runs and platforms unlike std::hash, for keys of on disk caches
+    inline uint64_t HashText(std::string_view text) {
+        uint64_t hash = 0xcbf29ce484222325;
+        for (char c : text) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001b3;
+        }
+        return hash;
+    }
+} // namespace IC
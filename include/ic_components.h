@@ -1,10 +1,12 @@
 #pragma once
 
 #include "ic_graphics.h"
+#include "ic_mesh_asset.h"
 
 #include <glm/glm.hpp>
 #include <imgui.h>
 
+#include <functional>
 #include <vector>
 
 namespace IC {
@@ -15,7 +17,17 @@ namespace IC {
 
         virtual void Gui() = 0;
 
+        // Called on the first change to the component's placement or bounds since ClearChanged, so owners only
+        // revisit components that changed instead of polling all of them.
+        void SetChangedCallback(std::function<void()> callback) { _changedCallback = std::move(callback); }
+        void ClearChanged() { _changed = false; }
+
     protected:
+        void MarkChanged();
+
+    private:
+        bool _changed = false;
+        std::function<void()> _changedCallback;
     };
 
     class Transform : public Component {
@@ -23,11 +35,23 @@ namespace IC {
         Transform();
         ~Transform();
 
-        glm::vec3 position = glm::vec3(0.0f);
-        glm::vec3 rotation = glm::vec3(0.0f);
-        glm::vec3 scale = glm::vec3(0.0f);
+        const glm::vec3 &Position() const { return _position; }
+        const glm::vec3 &Rotation() const { return _rotation; }
+        const glm::vec3 &Scale() const { return _scale; }
+
+        void SetPosition(const glm::vec3 &position);
+        void SetRotation(const glm::vec3 &rotation);
+        void SetScale(const glm::vec3 &scale);
+
+        // Scale, then rotation in degrees around x, y and z, then translation.
+        glm::mat4 ModelMatrix() const;
 
         void Gui() override;
+
+    private:
+        glm::vec3 _position = glm::vec3(0.0f);
+        glm::vec3 _rotation = glm::vec3(0.0f);
+        glm::vec3 _scale = glm::vec3(0.0f);
     };
 
     class Mesh : public Component {
@@ -35,40 +59,68 @@ namespace IC {
         Mesh();
         ~Mesh();
 
-        bool MeshUpdated() { return _meshUpdatedFlag; }
+        bool IsLoading() { return _pendingAsset != nullptr; }
         MaterialInstance *Material() { return _material.get(); }
-        std::vector<VertexData> &Vertices() { return _vertices; }
-        std::vector<uint32_t> &Indices() { return _indices; }
-        uint32_t VertexCount() { return _vertexCount; }
-        uint32_t IndexCount() { return _indexCount; }
+        std::shared_ptr<MeshAsset> &Asset() { return _asset; }
+        MeshResidency Residency() { return _residency; }
+        // Occluders hide the objects behind them when culling on the cpu. They need their vertex positions kept, so
+        // a GpuOnly residency leaves them without effect.
+        bool IsOccluder() { return _occluder; }
+        // Empty once the cpu data has been released, see MeshResidency.
+        std::vector<VertexData> &Vertices() { return MeshDataOrEmpty().vertices; }
+        std::vector<uint32_t> &Indices() { return MeshDataOrEmpty().indices; }
+        uint32_t VertexCount() { return _asset != nullptr ? _asset->VertexCount() : 0; }
+        uint32_t IndexCount() { return _asset != nullptr ? _asset->IndexCount() : 0; }
+        // Local bounds of the loaded asset, or of the placeholder cube drawn while it loads.
+        const BoundingBox &LocalBounds() { return IsAssetLoaded() ? _asset->Bounds() : PLACEHOLDER_BOUNDS; }
+        const BoundingSphere &LocalSphere() { return IsAssetLoaded() ? _asset->Sphere() : PLACEHOLDER_SPHERE; }
 
-        void ClearMeshUpdatedFlag() { _meshUpdatedFlag = false; }
         void SetMaterial(std::shared_ptr<MaterialInstance> &material) { _material = material; }
+        void SetOccluder(bool occluder) { _occluder = occluder; }
+
+        // Sets how much cpu data this mesh needs kept after gpu upload. Shared assets keep the most retentive
+        // policy requested by any of their meshes.
+        void SetResidency(MeshResidency residency);
+
+        // Acquires the mesh file from the asset cache, loading it on a worker thread if no other mesh uses it yet.
+        // The current geometry stays in use until the new asset has finished loading. The bound file is read from
+        // disk again.
+        MeshLoadHandle LoadMeshAsync();
+
+        // Applies a finished load, if any. Returns true when the mesh switched to new data. Marks the mesh changed
+        // when its bounds may have, including reloads of a shared asset.
+        bool PollLoad();
 
         void Gui() override;
 
     private:
-        void LoadMesh();
+        MeshData &MeshDataOrEmpty();
+        bool IsAssetLoaded() { return _asset != nullptr && _asset->IsLoaded(); }
 
         std::shared_ptr<MaterialInstance> _material;
         std::string _filename = "resources/models/cube.obj";
 
-        std::vector<VertexData> _vertices;
-        std::vector<uint32_t> _indices;
-        uint32_t _vertexCount;
-        uint32_t _indexCount;
-
-        bool _meshUpdatedFlag = false;
+        std::shared_ptr<MeshAsset> _asset;
+        std::shared_ptr<MeshAsset> _pendingAsset;
+        MeshResidency _residency = MeshResidency::KeepAll;
+        bool _occluder = false;
+        // asset version the bounds were last reported changed for
+        uint32_t _boundsVersion = 0;
     };
 
     class PointLight : public Component {
     public:
+        static constexpr float MAX_RANGE = 1000.0f;
+
         PointLight();
         ~PointLight();
 
         float Constant() { return _constant; }
         float Linear() { return _linear; }
         float Quadratic() { return _quadratic; }
+        // Distance at which the attenuation drops below 1/256, beyond which the light has no visible effect. Lights
+        // without falloff reach MAX_RANGE. Zero for lights too dim to be visible anywhere, which are skipped.
+        float Range();
 
         void Gui() override;
 
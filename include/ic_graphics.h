@@ -7,6 +7,8 @@
 #include <glm/gtx/hash.hpp>
 #include <imgui.h>
 
+#include <future>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -27,6 +29,47 @@ namespace IC {
             return pos == other.pos && normal == other.normal && color == other.color && texCoord == other.texCoord;
         }
     };
+
+    struct BoundingBox {
+        glm::vec3 min = glm::vec3(0.0f);
+        glm::vec3 max = glm::vec3(0.0f);
+
+        glm::vec3 Center() const { return 0.5f * (min + max); }
+        glm::vec3 Extents() const { return 0.5f * (max - min); }
+    };
+
+    struct BoundingSphere {
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+    };
+
+    // CPU side geometry of a mesh
+    struct MeshData {
+        std::vector<VertexData> vertices;
+        std::vector<uint32_t> indices;
+        // local space bounds, computed when the mesh is loaded
+        BoundingBox bounds;
+        BoundingSphere sphere;
+    };
+
+    // Resolves to the loaded mesh data, or nullptr if the file could not be loaded.
+    using MeshLoadHandle = std::shared_future<std::shared_ptr<MeshData>>;
+
+    // Parses an OBJ file into deduplicated vertex and index data. Returns nullptr on failure.
+    std::shared_ptr<MeshData> LoadMeshData(const std::string &filename);
+
+    // Unit cube centered on the origin, used in place of meshes that are still loading.
+    std::shared_ptr<MeshData> CreatePlaceholderMeshData();
+    const BoundingBox PLACEHOLDER_BOUNDS{glm::vec3(-0.5f), glm::vec3(0.5f)};
+    const BoundingSphere PLACEHOLDER_SPHERE{glm::vec3(0.0f), 0.866026f};
+
+    // Fits the box and sphere around the vertices. The sphere is centered on the box, which is close to minimal for
+    // typical meshes and needs a single pass.
+    void ComputeBounds(MeshData &meshData);
+
+    // Bounds of the transformed box or sphere. Boxes stay axis aligned, so rotated boxes grow.
+    BoundingBox TransformBounds(const BoundingBox &bounds, const glm::mat4 &transform);
+    BoundingSphere TransformBounds(const BoundingSphere &sphere, const glm::mat4 &transform);
 } // namespace IC
 
 namespace std {
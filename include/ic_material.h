@@ -35,6 +35,14 @@ namespace IC {
         ShaderDataType dataType;
     };
 
+    // Shader specialization constant that selects a material variant, such as the number of point lights or whether a
+    // texture is sampled. Every combination of values gets its own pipeline with the unused code compiled out.
+    struct ShaderVariantKey {
+        uint32_t constantId;
+        std::string name;
+        uint32_t defaultValue;
+    };
+
     struct ShaderBindingValue {
         ShaderBinding *binding;
         void *value;
@@ -47,8 +55,10 @@ namespace IC {
         ~MaterialTemplate(){};
 
         void AddBinding(int bindingIndex, std::string name, BindingType bindingType, ShaderDataType dataType);
+        void AddVariantKey(uint32_t constantId, std::string name, uint32_t defaultValue);
 
         std::map<int, ShaderBinding> &Bindings() { return _bindings; }
+        std::map<uint32_t, ShaderVariantKey> &VariantKeys() { return _variantKeys; }
 
         MaterialFlags flags;
 
@@ -57,6 +67,7 @@ namespace IC {
 
     private:
         std::map<int, ShaderBinding> _bindings;
+        std::map<uint32_t, ShaderVariantKey> _variantKeys;
     };
 
     class MaterialInstance {
@@ -68,8 +79,14 @@ namespace IC {
         MaterialTemplate &Template() { return _template; }
         void SetBindingValue(int index, void *value, size_t size);
 
+        // Must be set before the material is added to the renderer, as it selects the pipeline
+        void SetVariant(uint32_t constantId, uint32_t value);
+        // Value of a variant key, the template's default unless overridden
+        uint32_t VariantValue(uint32_t constantId);
+
     private:
         MaterialTemplate &_template;
         std::map<int, ShaderBindingValue> _bindingValues;
+        std::map<uint32_t, uint32_t> _variantValues;
     };
 } // namespace IC
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ic_graphics.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace IC {
+    // How much of a mesh is kept in system memory once it has been uploaded to the gpu.
+    // Ordered from most to least retained.
+    enum class MeshResidency {
+        // Keep vertices and indices.
+        KeepAll = 0,
+        // Keep vertex positions and indices only, e.g. for collision or picking.
+        PositionsOnly,
+        // Drop all cpu data. It is streamed back from disk when requested.
+        GpuOnly,
+        Count
+    };
+
+    // Mesh geometry loaded from one file and shared by every Mesh component that references it.
+    class MeshAsset {
+    public:
+        MeshAsset(std::string path) : _path{path} {}
+
+        const std::string &Path() { return _path; }
+        MeshLoadHandle &LoadHandle() { return _load; }
+        bool IsLoading() { return _load.valid(); }
+        bool IsLoaded() { return _version > 0; }
+        bool LoadFailed() { return _failed; }
+
+        // Full cpu data. May be nullptr after the residency policy has been applied.
+        std::shared_ptr<MeshData> &Data() { return _data; }
+        bool HasCpuData() { return _data != nullptr; }
+        // Vertex positions, kept by the PositionsOnly policy after the full data has been released.
+        std::vector<glm::vec3> &Positions() { return _positions; }
+        std::vector<uint32_t> &Indices() { return _data != nullptr ? _data->indices : _indices; }
+        uint32_t VertexCount() { return _vertexCount; }
+        uint32_t IndexCount() { return _indexCount; }
+        // Radius of a sphere around the mesh origin that encloses every vertex.
+        float BoundingRadius() { return _boundingRadius; }
+        // Local space bounds, kept when the cpu data is released.
+        const BoundingBox &Bounds() { return _bounds; }
+        const BoundingSphere &Sphere() { return _sphere; }
+
+        // Incremented every time new data is applied, so GPU copies can tell when they are stale.
+        uint32_t Version() { return _version; }
+
+        // Starts parsing the file on a worker thread.
+        void LoadAsync();
+
+        // Re-imports the file after it changed on disk. The current data stays in use until the new data is applied.
+        void Reload();
+
+        // Applies a finished load, if any. Returns true when new data was applied.
+        bool PollLoad();
+
+        // Users register the policy they need. The most retentive registered policy wins; KeepAll if none.
+        void AddResidencyRequest(MeshResidency residency);
+        void RemoveResidencyRequest(MeshResidency residency);
+        MeshResidency Residency();
+
+        // Releases cpu data the residency policy does not need, or streams released data back in if it needs more.
+        // Called once the data is on the gpu and whenever the policy changes.
+        void ApplyResidency();
+
+        // Streams released cpu data back in from disk. The handle is ready immediately if the data is resident.
+        MeshLoadHandle RequestCpuData();
+
+    private:
+        std::string _path;
+        MeshLoadHandle _load;
+        std::shared_ptr<MeshData> _data;
+        std::vector<glm::vec3> _positions;
+        std::vector<uint32_t> _indices;
+        uint32_t _vertexCount = 0;
+        uint32_t _indexCount = 0;
+        float _boundingRadius = 0.0f;
+        BoundingBox _bounds;
+        BoundingSphere _sphere;
+        uint32_t _version = 0;
+        uint32_t _residencyRequests[static_cast<size_t>(MeshResidency::Count)] = {};
+        bool _failed = false;
+        bool _restreaming = false;
+        // the data is streamed back in for a policy that needs more of it
+        bool _reapplyResidency = false;
+    };
+
+    // Registry of loaded mesh assets keyed by file path. Assets are freed when the last reference goes away.
+    class MeshAssetCache {
+    public:
+        // Returns the cached asset for a path, starting an asynchronous load if it is not cached yet.
+        static std::shared_ptr<MeshAsset> Acquire(const std::string &path);
+
+        // Returns the cached asset for a path without loading it, or nullptr if no one references it.
+        static std::shared_ptr<MeshAsset> Find(const std::string &path);
+
+        static size_t Count();
+
+    private:
+        static std::string NormalizePath(const std::string &path);
+
+        static std::mutex _mutex;
+        static std::unordered_map<std::string, std::weak_ptr<MeshAsset>> _assets;
+    };
+} // namespace IC
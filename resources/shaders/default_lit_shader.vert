@@ -1,20 +1,23 @@
 #version 450
 
-layout(set = 0, binding = 0) uniform UniformBufferObject {
+#extension GL_GOOGLE_include_directive : require
+#include "object_data.glsl"
+
+layout(set = 0, binding = 0) uniform CameraData {
     mat4 proj;
+    mat4 view;
 }
-proj;
+camera;
 
 layout(set = 2, binding = 0) uniform ColorProperty {
     vec4 color;
 }
 materialColor;
 
-layout(push_constant) uniform PushConstants {
-    mat4 model;
-    mat4 view;
+layout(std430, set = 0, binding = 2) readonly buffer ObjectBuffer {
+    ObjectData objects[];
 }
-mv;
+objectBuffer;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -25,11 +28,19 @@ layout(location = 0) out vec4 fragColor;
 layout(location = 1) out vec3 fragPos;
 layout(location = 2) out vec3 normal;
 layout(location = 3) out vec2 fragTexCoord;
+layout(location = 4) flat out uint fragObjectIndex;
+
+// the depth prepass runs this shader in another pipeline, whose depth is tested for equality
+invariant gl_Position;
 
 void main() {
-    gl_Position = proj.proj * mv.view * mv.model * vec4(inPosition, 1.0);
-    normal = mat3(transpose(inverse(mv.view * mv.model))) * inNormal;
+    // objects are drawn with their slot in the object buffer as the instance index
+    ObjectData object = objectBuffer.objects[gl_InstanceIndex];
+    vec4 viewPos = camera.view * object.model * vec4(inPosition, 1.0);
+    gl_Position = camera.proj * viewPos;
+    normal = mat3(camera.view) * mat3(object.normal) * inNormal;
     fragColor = materialColor.color;
-    fragPos = vec3(mv.view * mv.model * vec4(inPosition, 1.0));
+    fragPos = viewPos.xyz;
     fragTexCoord = inTexCoord;
+    fragObjectIndex = uint(gl_InstanceIndex);
 }
\ No newline at end of file
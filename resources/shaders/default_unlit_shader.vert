@@ -1,20 +1,23 @@
 #version 450
 
-layout(set = 0, binding = 0) uniform UniformBufferObject {
+#extension GL_GOOGLE_include_directive : require
+#include "object_data.glsl"
+
+layout(set = 0, binding = 0) uniform CameraData {
     mat4 proj;
+    mat4 view;
 }
-proj;
+camera;
 
 layout(set = 1, binding = 0) uniform MaterialConstants {
     vec4 color;
 }
 constants;
 
-layout(push_constant) uniform PushConstants {
-    mat4 model;
-    mat4 view;
+layout(std430, set = 0, binding = 2) readonly buffer ObjectBuffer {
+    ObjectData objects[];
 }
-mv;
+objectBuffer;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -26,8 +29,9 @@ layout(location = 1) out vec3 normal;
 layout(location = 2) out vec2 fragTexCoord;
 
 void main() {
-    gl_Position = proj.proj * mv.view * mv.model * vec4(inPosition, 1.0);
-    normal = normalize((mv.model * vec4(inNormal, 0.0)).xyz);
+    ObjectData object = objectBuffer.objects[gl_InstanceIndex];
+    gl_Position = camera.proj * camera.view * object.model * vec4(inPosition, 1.0);
+    normal = normalize(mat3(camera.view) * mat3(object.normal) * inNormal);
     fragColor = constants.color;
     fragTexCoord = inTexCoord;
 }
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 450
+
+// drawn while an object's own pipeline is still compiling, plain grey with a light from the camera
+layout(location = 0) in vec3 normal;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    float light = 0.3 + 0.5 * abs(normalize(normal).z);
+    outColor = vec4(vec3(light), 1.0);
+}
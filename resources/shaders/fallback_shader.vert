@@ -0,0 +1,28 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#include "object_data.glsl"
+
+layout(set = 0, binding = 0) uniform CameraData {
+    mat4 proj;
+    mat4 view;
+}
+camera;
+
+layout(std430, set = 0, binding = 2) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+}
+objectBuffer;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec3 inColor;
+layout(location = 3) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 normal;
+
+void main() {
+    ObjectData object = objectBuffer.objects[gl_InstanceIndex];
+    gl_Position = camera.proj * camera.view * object.model * vec4(inPosition, 1.0);
+    normal = mat3(camera.view) * mat3(object.normal) * inNormal;
+}
@@ -1,4 +1,10 @@
-#define MAX_POINT_LIGHTS 4
+#include "object_data.glsl"
+
+// material variant switches, set per pipeline through specialization constants
+// materials without point lights skip the cluster lookup
+layout(constant_id = 0) const bool POINT_LIGHTS = true;
+layout(constant_id = 1) const bool DIFFUSE_TEXTURE = true;
+layout(constant_id = 2) const bool SPECULAR = true;
 
 struct DirectionalLightData {
     vec3 dir;
@@ -10,61 +16,109 @@ struct DirectionalLightData {
 
 struct PointLightData {
     vec3 pos;
+    // distance beyond which the light is ignored
+    float range;
 
     vec3 amb;
-    vec3 diff;
-    vec3 spec;
-
     float cons;
+    vec3 diff;
     float lin;
+    vec3 spec;
     float quad;
 };
 
 layout(set = 1, binding = 0) uniform SceneLightData {
     DirectionalLightData directional;
-    PointLightData[MAX_POINT_LIGHTS] pointLights;
-    uint numPointLights;
+    uvec3 clusterCounts;
+    // depth slice of a view space depth d is log(d) * sliceScale + sliceBias
+    float sliceScale;
+    // size of a cluster on screen in pixels
+    vec2 clusterSize;
+    float sliceBias;
 }
 lightData;
 
-layout(set = 2, binding = 1) uniform sampler2D diffuseTexture;
-layout(set = 2, binding = 2) uniform sampler2D specularMask;
-
-vec3 calcPointLight(PointLightData light, vec2 texCoord, vec3 normal, vec3 fragPos) {
-    // vectors
-    vec3 lightDir = normalize(light.pos - fragPos);
-    vec3 viewDir = normalize(-fragPos);
-    vec3 reflectDir = reflect(-lightDir, normal);
+layout(std430, set = 1, binding = 1) readonly buffer PointLightBuffer {
+    PointLightData pointLights[];
+}
+pointLightBuffer;
 
-    float lightDistance = length(light.pos - fragPos);
+// offset and count of each cluster's lights in the light index list
+layout(std430, set = 1, binding = 2) readonly buffer ClusterBuffer {
+    uvec2 clusters[];
+}
+clusterBuffer;
 
-    // scalar calculations
-    float diff = max(dot(normal, lightDir), 0.0);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    float attenuation = 1.0 / (light.cons + light.lin * lightDistance + light.quad * (lightDistance * lightDistance));
+layout(std430, set = 1, binding = 3) readonly buffer LightIndexBuffer {
+    uint lightIndices[];
+}
+lightIndexBuffer;
 
-    // final values
-    vec3 ambient = light.amb * attenuation * vec3(texture(diffuseTexture, texCoord));
-    vec3 diffuse = diff * light.diff * attenuation * vec3(texture(diffuseTexture, texCoord));
-    vec3 specular = spec * light.spec * attenuation * vec3(texture(specularMask, texCoord));
+layout(std430, set = 0, binding = 2) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+}
+objectBuffer;
+
+layout(set = 2, binding = 1) uniform sampler2DArray diffuseTexture;
+layout(set = 2, binding = 2) uniform sampler2DArray specularMask;
+
+// everything the lights need to know about a fragment. Textures are sampled once here and shared by all lights.
+struct SurfaceData {
+    vec3 diffuse;
+    vec3 specular;
+    vec3 normal;
+    vec3 viewDir;
+    vec3 fragPos;
+};
 
-    return (ambient + diffuse + specular);
+// objectIndex is the instance index the vertex shader read the object with
+SurfaceData sampleSurface(vec2 texCoord, vec3 normal, vec3 fragPos, uint objectIndex) {
+    SurfaceData surface;
+    surface.diffuse = vec3(1.0);
+    if (DIFFUSE_TEXTURE) {
+        uint layer = objectBuffer.objects[objectIndex].textureLayers[1];
+        surface.diffuse = texture(diffuseTexture, vec3(texCoord, layer)).rgb;
+    }
+    surface.specular = vec3(0.0);
+    if (SPECULAR) {
+        uint layer = objectBuffer.objects[objectIndex].textureLayers[2];
+        surface.specular = texture(specularMask, vec3(texCoord, layer)).rgb;
+    }
+    surface.normal = normalize(normal);
+    surface.viewDir = normalize(-fragPos);
+    surface.fragPos = fragPos;
+    return surface;
 }
 
-vec3 calcDirectionalLight(DirectionalLightData light, vec2 texCoord, vec3 normal, vec3 fragPos) {
-    // vectors
-    vec3 lightDir = normalize(-light.dir);
-    vec3 viewDir = normalize(-fragPos);
-    vec3 reflectDir = reflect(-lightDir, normal);
+vec3 calcLight(vec3 lightDir, vec3 amb, vec3 diff, vec3 spec, SurfaceData surface) {
+    float diffuseFactor = max(dot(surface.normal, lightDir), 0.0);
+    vec3 result = (amb + diffuseFactor * diff) * surface.diffuse;
+    if (SPECULAR) {
+        vec3 reflectDir = reflect(-lightDir, surface.normal);
+        result += pow(max(dot(surface.viewDir, reflectDir), 0.0), 32) * spec * surface.specular;
+    }
+    return result;
+}
 
-    // scalar calculations
-    float diff = max(dot(normal, lightDir), 0.0);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+vec3 calcPointLight(PointLightData light, SurfaceData surface) {
+    vec3 toLight = light.pos - surface.fragPos;
+    float lightDistance = length(toLight);
+    float attenuation = 1.0 / (light.cons + light.lin * lightDistance + light.quad * (lightDistance * lightDistance));
+    // fades out towards the range, so lights don't cut off at cluster borders
+    float window = clamp(1.0 - pow(lightDistance / light.range, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+    return attenuation * calcLight(toLight / lightDistance, light.amb, light.diff, light.spec, surface);
+}
 
-    // final values
-    vec3 ambient = light.amb * vec3(texture(diffuseTexture, texCoord));
-    vec3 diffuse = diff * light.diff * vec3(texture(diffuseTexture, texCoord));
-    vec3 specular = spec * light.spec * vec3(texture(specularMask, texCoord));
+// the light index range of the cluster a fragment falls into, depth is the view space distance along -z
+uvec2 clusterLights(vec2 fragCoord, float depth) {
+    uvec3 counts = lightData.clusterCounts;
+    uvec2 tile = min(uvec2(fragCoord / lightData.clusterSize), counts.xy - 1);
+    float slice = log(depth) * lightData.sliceScale + lightData.sliceBias;
+    uint z = uint(clamp(slice, 0.0, float(counts.z - 1)));
+    return clusterBuffer.clusters[(z * counts.y + tile.y) * counts.x + tile.x];
+}
 
-    return (ambient + diffuse + specular);
-}
\ No newline at end of file
+vec3 calcDirectionalLight(DirectionalLightData light, SurfaceData surface) {
+    return calcLight(normalize(-light.dir), light.amb, light.diff, light.spec, surface);
+}
@@ -0,0 +1,18 @@
+#define MAX_MATERIAL_TEXTURES 8
+
+// per object data written by the renderer every frame, see GpuObjectData
+struct ObjectData {
+    mat4 model;
+    // inverse transpose of the model matrix, stored as a mat4 as mat3 columns are padded to vec4 anyway
+    mat4 normal;
+    // world space bounding sphere, center in xyz and radius in w
+    vec4 sphere;
+    uint indexCount;
+    // draw batch of the object and the first indirect command slot of that batch
+    uint batch;
+    uint firstCommand;
+    // index of the render object, which keeps its visibility across frames
+    uint renderIndex;
+    // array layer sampled by each material texture binding, textures may be packed into a shared array
+    uint textureLayers[MAX_MATERIAL_TEXTURES];
+};
@@ -1,5 +1,6 @@
 #include <ic_app.h>
 
+#include "ic_job_system.h"
 #include "ic_renderer.h"
 #include <ic_gameobject.h>
 #include <ic_log.h>
@@ -22,6 +23,7 @@ namespace {
 
 bool App::Run(const Config *c) {
     Log::Init();
+    JobSystem::Init();
 
     // Copy config over.
     appConfig = *c;
@@ -47,6 +49,7 @@ bool App::Run(const Config *c) {
 
         glfwDestroyWindow(window);
         glfwTerminate();
+        JobSystem::Shutdown();
 
         return false;
     }
@@ -55,14 +58,18 @@ bool App::Run(const Config *c) {
     meshMaterial.AddBinding(0, "color", BindingType::Uniform, ShaderDataType::Vec4);
     meshMaterial.AddBinding(1, "diffuse", BindingType::Texture, ShaderDataType::String);
     meshMaterial.AddBinding(2, "specular", BindingType::Texture, ShaderDataType::String);
-    meshMaterial.vertShaderData = "resources/shaders/default_lit_shader.vert.spv";
-    meshMaterial.fragShaderData = "resources/shaders/default_lit_shader.frag.spv";
+    meshMaterial.vertShaderData = "resources/shaders/default_lit_shader.vert";
+    meshMaterial.fragShaderData = "resources/shaders/default_lit_shader.frag";
     meshMaterial.flags = MaterialFlags::Lit;
+    // variant keys match the specialization constants in lighting_headers.glsl
+    meshMaterial.AddVariantKey(0, "pointLights", 1);
+    meshMaterial.AddVariantKey(1, "diffuseTexture", 1);
+    meshMaterial.AddVariantKey(2, "specular", 1);
 
     MaterialTemplate unlitMaterial{};
     unlitMaterial.AddBinding(0, "color", BindingType::Uniform, ShaderDataType::Vec4);
-    unlitMaterial.vertShaderData = "resources/shaders/default_unlit_shader.vert.spv";
-    unlitMaterial.fragShaderData = "resources/shaders/default_unlit_shader.frag.spv";
+    unlitMaterial.vertShaderData = "resources/shaders/default_unlit_shader.vert";
+    unlitMaterial.fragShaderData = "resources/shaders/default_unlit_shader.frag";
     unlitMaterial.flags = MaterialFlags::None;
 
     glm::vec4 color = {0.8f, 0.8f, 0.8f, 1.0f};
@@ -81,14 +88,14 @@ bool App::Run(const Config *c) {
     auto mesh = std::make_shared<GameObject>("test mesh");
     auto meshComponent = mesh->AddComponent<Mesh>();
     meshComponent->SetMaterial(meshMaterialInstance);
-    mesh->GetTransform()->scale = glm::vec3(0.5f);
+    mesh->GetTransform()->SetScale(glm::vec3(0.5f));
 
     // test light
     auto pointLight = std::make_shared<GameObject>("point light");
     pointLight->AddComponent<PointLight>();
     auto pointLightMesh = pointLight->AddComponent<Mesh>();
-    pointLight->GetTransform()->position = glm::vec3(1.7f, 1.0f, 1.0f);
-    pointLight->GetTransform()->scale = glm::vec3(0.1f);
+    pointLight->GetTransform()->SetPosition(glm::vec3(1.7f, 1.0f, 1.0f));
+    pointLight->GetTransform()->SetScale(glm::vec3(0.1f));
     pointLightMesh->SetMaterial(unlitMaterialInstance);
 
     // directional light
@@ -113,6 +120,7 @@ bool App::Run(const Config *c) {
     appRendererApi = nullptr;
     glfwDestroyWindow(window);
     glfwTerminate();
+    JobSystem::Shutdown();
 
     return true;
 }
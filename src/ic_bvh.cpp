@@ -0,0 +1,457 @@
+#include "ic_bvh.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+
+namespace IC {
+    namespace {
+        // rebuild once refitting and inserting made the tree this much more expensive than a fresh build
+        constexpr float REBUILD_COST_RATIO = 1.5f;
+        constexpr size_t SAH_BINS = 12;
+
+        BoundingBox Union(const BoundingBox &a, const BoundingBox &b) {
+            return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+        }
+
+        float SurfaceArea(const BoundingBox &bounds) {
+            glm::vec3 size = glm::max(bounds.max - bounds.min, glm::vec3(0.0f));
+            return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+
+        bool Overlaps(const BoundingBox &a, const BoundingBox &b) {
+            return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::lessThanEqual(b.min, a.max));
+        }
+
+        bool Overlaps(const BoundingBox &bounds, const BoundingSphere &sphere) {
+            glm::vec3 closest = glm::clamp(sphere.center, bounds.min, bounds.max);
+            glm::vec3 offset = closest - sphere.center;
+            return glm::dot(offset, offset) <= sphere.radius * sphere.radius;
+        }
+
+        // slab test, inverseDirection may contain infinities for axis aligned rays
+        bool Overlaps(const BoundingBox &bounds, const Ray &ray, const glm::vec3 &inverseDirection, float maxDistance) {
+            glm::vec3 t0 = (bounds.min - ray.origin) * inverseDirection;
+            glm::vec3 t1 = (bounds.max - ray.origin) * inverseDirection;
+            glm::vec3 entries = glm::min(t0, t1);
+            glm::vec3 exits = glm::max(t0, t1);
+            float entry = std::max({entries.x, entries.y, entries.z, 0.0f});
+            float exit = std::min({exits.x, exits.y, exits.z, maxDistance});
+            return entry <= exit;
+        }
+    } // namespace
+
+    uint32_t BoundingVolumeHierarchy::Insert(const BoundingBox &bounds, uint32_t userData) {
+        uint32_t proxy;
+        if (!_freeProxies.empty()) {
+            proxy = _freeProxies.back();
+            _freeProxies.pop_back();
+        } else {
+            proxy = static_cast<uint32_t>(_proxies.size());
+            _proxies.emplace_back();
+        }
+        _proxyCount++;
+
+        uint32_t leaf = AllocateNode();
+        _nodes[leaf].bounds = bounds;
+        _nodes[leaf].proxy = proxy;
+        _proxies[proxy] = {bounds, userData, leaf};
+        InsertLeaf(leaf);
+        return proxy;
+    }
+
+    void BoundingVolumeHierarchy::Remove(uint32_t proxy) {
+        uint32_t leaf = _proxies[proxy].node;
+        RemoveLeaf(leaf);
+        FreeNode(leaf);
+        _proxies[proxy] = {};
+        _freeProxies.push_back(proxy);
+        _proxyCount--;
+    }
+
+    void BoundingVolumeHierarchy::Move(uint32_t proxy, const BoundingBox &bounds) {
+        Proxy &item = _proxies[proxy];
+        if (item.bounds.min == bounds.min && item.bounds.max == bounds.max) {
+            return;
+        }
+        item.bounds = bounds;
+        _nodes[item.node].bounds = bounds;
+        _movedProxies.push_back(proxy);
+    }
+
+    void BoundingVolumeHierarchy::Commit() {
+        // one walk to the root per moved item, unless so many moved that a single pass over the tree is cheaper
+        if (_movedProxies.size() * std::bit_width(_proxyCount) > _nodes.size()) {
+            RefitAll();
+        } else {
+            for (uint32_t proxy : _movedProxies) {
+                uint32_t leaf = _proxies[proxy].node;
+                if (leaf != INVALID_PROXY) {
+                    RefitAncestors(_nodes[leaf].parent);
+                }
+            }
+        }
+        _movedProxies.clear();
+
+        if (_proxyCount > 2 && Cost() > _builtCost * REBUILD_COST_RATIO) {
+            Rebuild();
+        }
+    }
+
+    void BoundingVolumeHierarchy::Rebuild() {
+        std::vector<uint32_t> proxies;
+        proxies.reserve(_proxyCount);
+        for (uint32_t proxy = 0; proxy < _proxies.size(); proxy++) {
+            if (_proxies[proxy].node != INVALID_PROXY) {
+                proxies.push_back(proxy);
+            }
+        }
+
+        _nodes.clear();
+        _freeNodes.clear();
+        _nodes.reserve(proxies.size() * 2);
+        _innerArea = 0.0f;
+        _root = proxies.empty() ? INVALID_PROXY : Build(proxies, 0, proxies.size(), INVALID_PROXY);
+        _movedProxies.clear();
+
+        _builtCost = Cost();
+    }
+
+    float BoundingVolumeHierarchy::Cost() const {
+        if (_root == INVALID_PROXY) {
+            return 0.0f;
+        }
+        float rootArea = SurfaceArea(_nodes[_root].bounds);
+        return rootArea > 0.0f ? _innerArea / rootArea : 0.0f;
+    }
+
+    void BoundingVolumeHierarchy::QueryBox(const BoundingBox &bounds, std::vector<uint32_t> &results) const {
+        if (_root == INVALID_PROXY) {
+            return;
+        }
+        std::vector<uint32_t> stack{_root};
+        while (!stack.empty()) {
+            const Node &node = _nodes[stack.back()];
+            stack.pop_back();
+            if (!Overlaps(node.bounds, bounds)) {
+                continue;
+            }
+            if (node.IsLeaf()) {
+                results.push_back(_proxies[node.proxy].userData);
+            } else {
+                stack.push_back(node.children[0]);
+                stack.push_back(node.children[1]);
+            }
+        }
+    }
+
+    void BoundingVolumeHierarchy::QuerySphere(const BoundingSphere &sphere, std::vector<uint32_t> &results) const {
+        if (_root == INVALID_PROXY) {
+            return;
+        }
+        std::vector<uint32_t> stack{_root};
+        while (!stack.empty()) {
+            const Node &node = _nodes[stack.back()];
+            stack.pop_back();
+            if (!Overlaps(node.bounds, sphere)) {
+                continue;
+            }
+            if (node.IsLeaf()) {
+                results.push_back(_proxies[node.proxy].userData);
+            } else {
+                stack.push_back(node.children[0]);
+                stack.push_back(node.children[1]);
+            }
+        }
+    }
+
+    void BoundingVolumeHierarchy::QueryRay(const Ray &ray, float maxDistance, std::vector<uint32_t> &results) const {
+        if (_root == INVALID_PROXY) {
+            return;
+        }
+        glm::vec3 inverseDirection = 1.0f / ray.direction;
+        std::vector<uint32_t> stack{_root};
+        while (!stack.empty()) {
+            const Node &node = _nodes[stack.back()];
+            stack.pop_back();
+            if (!Overlaps(node.bounds, ray, inverseDirection, maxDistance)) {
+                continue;
+            }
+            if (node.IsLeaf()) {
+                results.push_back(_proxies[node.proxy].userData);
+            } else {
+                stack.push_back(node.children[0]);
+                stack.push_back(node.children[1]);
+            }
+        }
+    }
+
+    void BoundingVolumeHierarchy::QueryFrustum(const Frustum &frustum, std::vector<uint32_t> &inside,
+                                               std::vector<uint32_t> &intersecting) const {
+        if (_root == INVALID_PROXY) {
+            return;
+        }
+        std::vector<uint32_t> stack{_root};
+        std::vector<uint32_t> subtreeStack;
+        while (!stack.empty()) {
+            uint32_t index = stack.back();
+            const Node &node = _nodes[index];
+            stack.pop_back();
+
+            Containment containment = frustum.Classify(node.bounds);
+            if (containment == Containment::Outside) {
+                continue;
+            }
+            if (containment == Containment::Inside) {
+                // nothing below needs testing
+                CollectLeaves(index, inside, subtreeStack);
+            } else if (node.IsLeaf()) {
+                intersecting.push_back(_proxies[node.proxy].userData);
+            } else {
+                stack.push_back(node.children[0]);
+                stack.push_back(node.children[1]);
+            }
+        }
+    }
+
+    uint32_t BoundingVolumeHierarchy::AllocateNode() {
+        if (!_freeNodes.empty()) {
+            uint32_t node = _freeNodes.back();
+            _freeNodes.pop_back();
+            _nodes[node] = {};
+            return node;
+        }
+        _nodes.emplace_back();
+        return static_cast<uint32_t>(_nodes.size() - 1);
+    }
+
+    void BoundingVolumeHierarchy::FreeNode(uint32_t node) {
+        _nodes[node] = {};
+        _freeNodes.push_back(node);
+    }
+
+    // Descends towards the sibling whose new parent adds the least surface area, like Box2D's dynamic tree.
+    void BoundingVolumeHierarchy::InsertLeaf(uint32_t leaf) {
+        if (_root == INVALID_PROXY) {
+            _root = leaf;
+            _nodes[leaf].parent = INVALID_PROXY;
+            return;
+        }
+
+        BoundingBox leafBounds = _nodes[leaf].bounds;
+        uint32_t sibling = _root;
+        while (!_nodes[sibling].IsLeaf()) {
+            const Node &node = _nodes[sibling];
+            float area = SurfaceArea(node.bounds);
+            float combinedArea = SurfaceArea(Union(node.bounds, leafBounds));
+
+            // cost of pairing the leaf with this node, and the cost every ancestor pays for growing
+            float pairCost = 2.0f * combinedArea;
+            float inheritedCost = 2.0f * (combinedArea - area);
+
+            float childCosts[2];
+            for (int i = 0; i < 2; i++) {
+                const Node &child = _nodes[node.children[i]];
+                float grownArea = SurfaceArea(Union(child.bounds, leafBounds));
+                childCosts[i] = child.IsLeaf() ? grownArea + inheritedCost
+                                               : grownArea - SurfaceArea(child.bounds) + inheritedCost;
+            }
+
+            if (pairCost < childCosts[0] && pairCost < childCosts[1]) {
+                break;
+            }
+            sibling = childCosts[0] < childCosts[1] ? node.children[0] : node.children[1];
+        }
+
+        uint32_t oldParent = _nodes[sibling].parent;
+        uint32_t newParent = AllocateNode();
+        _nodes[newParent].parent = oldParent;
+        _nodes[newParent].bounds = Union(leafBounds, _nodes[sibling].bounds);
+        _innerArea += SurfaceArea(_nodes[newParent].bounds);
+        _nodes[newParent].children[0] = sibling;
+        _nodes[newParent].children[1] = leaf;
+        _nodes[sibling].parent = newParent;
+        _nodes[leaf].parent = newParent;
+
+        if (oldParent == INVALID_PROXY) {
+            _root = newParent;
+        } else {
+            Node &parent = _nodes[oldParent];
+            parent.children[parent.children[0] == sibling ? 0 : 1] = newParent;
+        }
+        RefitAncestors(_nodes[newParent].parent);
+    }
+
+    void BoundingVolumeHierarchy::RemoveLeaf(uint32_t leaf) {
+        if (leaf == _root) {
+            _root = INVALID_PROXY;
+            return;
+        }
+
+        // the sibling takes the place of the parent
+        uint32_t parent = _nodes[leaf].parent;
+        uint32_t grandParent = _nodes[parent].parent;
+        uint32_t sibling = _nodes[parent].children[_nodes[parent].children[0] == leaf ? 1 : 0];
+        _nodes[sibling].parent = grandParent;
+        if (grandParent == INVALID_PROXY) {
+            _root = sibling;
+        } else {
+            Node &node = _nodes[grandParent];
+            node.children[node.children[0] == parent ? 0 : 1] = sibling;
+            RefitAncestors(grandParent);
+        }
+        _innerArea -= SurfaceArea(_nodes[parent].bounds);
+        FreeNode(parent);
+    }
+
+    // Stops at the first box that stays the same, as the boxes above it can't change either
+    void BoundingVolumeHierarchy::RefitAncestors(uint32_t node) {
+        while (node != INVALID_PROXY) {
+            Node &current = _nodes[node];
+            BoundingBox bounds = Union(_nodes[current.children[0]].bounds, _nodes[current.children[1]].bounds);
+            if (bounds.min == current.bounds.min && bounds.max == current.bounds.max) {
+                return;
+            }
+            _innerArea += SurfaceArea(bounds) - SurfaceArea(current.bounds);
+            current.bounds = bounds;
+            node = current.parent;
+        }
+    }
+
+    // Recomputes every inner box bottom up, in one pass rather than one walk to the root per moved item.
+    void BoundingVolumeHierarchy::RefitAll() {
+        _innerArea = 0.0f;
+        if (_root == INVALID_PROXY) {
+            return;
+        }
+
+        std::vector<uint32_t> order;
+        order.reserve(_nodes.size());
+        order.push_back(_root);
+        for (size_t i = 0; i < order.size(); i++) {
+            const Node &node = _nodes[order[i]];
+            if (!node.IsLeaf()) {
+                order.push_back(node.children[0]);
+                order.push_back(node.children[1]);
+            }
+        }
+
+        // children always come after their parents in breadth first order, the area is summed up on the way
+        for (auto it = order.rbegin(); it != order.rend(); it++) {
+            Node &node = _nodes[*it];
+            if (!node.IsLeaf()) {
+                node.bounds = Union(_nodes[node.children[0]].bounds, _nodes[node.children[1]].bounds);
+                _innerArea += SurfaceArea(node.bounds);
+            }
+        }
+    }
+
+    // Binned SAH build: items are split along the longest axis of their centroids, at the bin boundary minimizing
+    // area times item count on both sides.
+    uint32_t BoundingVolumeHierarchy::Build(std::vector<uint32_t> &proxies, size_t begin, size_t end,
+                                            uint32_t parent) {
+        uint32_t index = AllocateNode();
+        _nodes[index].parent = parent;
+
+        if (end - begin == 1) {
+            uint32_t proxy = proxies[begin];
+            _nodes[index].bounds = _proxies[proxy].bounds;
+            _nodes[index].proxy = proxy;
+            _proxies[proxy].node = index;
+            return index;
+        }
+
+        BoundingBox bounds = _proxies[proxies[begin]].bounds;
+        BoundingBox centroids{bounds.Center(), bounds.Center()};
+        for (size_t i = begin; i < end; i++) {
+            const BoundingBox &itemBounds = _proxies[proxies[i]].bounds;
+            bounds = Union(bounds, itemBounds);
+            centroids.min = glm::min(centroids.min, itemBounds.Center());
+            centroids.max = glm::max(centroids.max, itemBounds.Center());
+        }
+        _nodes[index].bounds = bounds;
+        _innerArea += SurfaceArea(bounds);
+
+        glm::vec3 centroidSize = centroids.max - centroids.min;
+        int axis = centroidSize.x > centroidSize.y ? (centroidSize.x > centroidSize.z ? 0 : 2)
+                                                   : (centroidSize.y > centroidSize.z ? 1 : 2);
+        size_t mid = begin + (end - begin) / 2;
+
+        if (centroidSize[axis] > 0.0f) {
+            float binScale = SAH_BINS / centroidSize[axis];
+            auto binOf = [&](uint32_t proxy) {
+                float offset = _proxies[proxy].bounds.Center()[axis] - centroids.min[axis];
+                return std::min(static_cast<size_t>(offset * binScale), SAH_BINS - 1);
+            };
+
+            std::array<uint32_t, SAH_BINS> counts{};
+            std::array<BoundingBox, SAH_BINS> binBounds;
+            for (size_t i = begin; i < end; i++) {
+                size_t bin = binOf(proxies[i]);
+                binBounds[bin] = counts[bin] == 0 ? _proxies[proxies[i]].bounds
+                                                  : Union(binBounds[bin], _proxies[proxies[i]].bounds);
+                counts[bin]++;
+            }
+
+            // sweep from the right to get the cost of every right side, then from the left to find the best split
+            std::array<float, SAH_BINS> rightCosts{};
+            BoundingBox rightBounds;
+            uint32_t rightCount = 0;
+            for (size_t bin = SAH_BINS - 1; bin > 0; bin--) {
+                if (counts[bin] > 0) {
+                    rightBounds = rightCount == 0 ? binBounds[bin] : Union(rightBounds, binBounds[bin]);
+                    rightCount += counts[bin];
+                }
+                rightCosts[bin] = rightCount == 0 ? 0.0f : SurfaceArea(rightBounds) * rightCount;
+            }
+
+            float bestCost = std::numeric_limits<float>::max();
+            size_t bestSplit = 0;
+            BoundingBox leftBounds;
+            uint32_t leftCount = 0;
+            for (size_t split = 1; split < SAH_BINS; split++) {
+                if (counts[split - 1] > 0) {
+                    leftBounds = leftCount == 0 ? binBounds[split - 1] : Union(leftBounds, binBounds[split - 1]);
+                    leftCount += counts[split - 1];
+                }
+                if (leftCount == 0 || leftCount == end - begin) {
+                    continue;
+                }
+                float cost = SurfaceArea(leftBounds) * leftCount + rightCosts[split];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestSplit = split;
+                }
+            }
+
+            if (bestSplit > 0) {
+                auto it = std::partition(proxies.begin() + begin, proxies.begin() + end,
+                                         [&](uint32_t proxy) { return binOf(proxy) < bestSplit; });
+                mid = static_cast<size_t>(it - proxies.begin());
+            }
+        }
+
+        uint32_t left = Build(proxies, begin, mid, index);
+        uint32_t right = Build(proxies, mid, end, index);
+        _nodes[index].children[0] = left;
+        _nodes[index].children[1] = right;
+        return index;
+    }
+
+    void BoundingVolumeHierarchy::CollectLeaves(uint32_t node, std::vector<uint32_t> &results,
+                                                std::vector<uint32_t> &stack) const {
+        stack.clear();
+        stack.push_back(node);
+        while (!stack.empty()) {
+            const Node &current = _nodes[stack.back()];
+            stack.pop_back();
+            if (current.IsLeaf()) {
+                results.push_back(_proxies[current.proxy].userData);
+            } else {
+                stack.push_back(current.children[0]);
+                stack.push_back(current.children[1]);
+            }
+        }
+    }
+} // namespace IC
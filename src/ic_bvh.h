@@ -0,0 +1,90 @@
+#pragma once
+
+#include "ic_culling.h"
+
+#include <ic_graphics.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace IC {
+    struct Ray {
+        glm::vec3 origin;
+        glm::vec3 direction;
+    };
+
+    // Dynamic bounding volume hierarchy over axis aligned boxes, with one item per leaf.
+    // Inserted items are placed where they grow the tree least, moved items only refit the boxes above them, so a
+    // frame costs in proportion to what moved. Once refitting has made the tree noticeably worse than a fresh build,
+    // it is rebuilt top down with the surface area heuristic. Items are addressed by proxy ids, which stay valid
+    // across rebuilds.
+    class BoundingVolumeHierarchy {
+    public:
+        static constexpr uint32_t INVALID_PROXY = UINT32_MAX;
+
+        uint32_t Insert(const BoundingBox &bounds, uint32_t userData);
+        void Remove(uint32_t proxy);
+        // Takes effect on the next Commit.
+        void Move(uint32_t proxy, const BoundingBox &bounds);
+
+        // Refits the ancestors of moved items and rebuilds the tree if its quality has degraded. Call before querying.
+        void Commit();
+        void Rebuild();
+
+        uint32_t UserData(uint32_t proxy) { return _proxies[proxy].userData; }
+        const BoundingBox &Bounds(uint32_t proxy) { return _proxies[proxy].bounds; }
+        size_t Size() { return _proxyCount; }
+        // Summed surface area of the inner nodes relative to the root, the expected number of inner nodes a random
+        // ray visits. Lower is better.
+        float Cost() const;
+
+        // Queries append the user data of every item whose box passes the test.
+        void QueryBox(const BoundingBox &bounds, std::vector<uint32_t> &results) const;
+        void QuerySphere(const BoundingSphere &sphere, std::vector<uint32_t> &results) const;
+        void QueryRay(const Ray &ray, float maxDistance, std::vector<uint32_t> &results) const;
+        // Items in subtrees fully inside the frustum go to inside, items whose own box crosses a plane to intersecting.
+        void QueryFrustum(const Frustum &frustum, std::vector<uint32_t> &inside,
+                          std::vector<uint32_t> &intersecting) const;
+
+    private:
+        struct Node {
+            BoundingBox bounds;
+            uint32_t parent = INVALID_PROXY;
+            uint32_t children[2] = {INVALID_PROXY, INVALID_PROXY};
+            // set for leaves only
+            uint32_t proxy = INVALID_PROXY;
+
+            bool IsLeaf() const { return children[0] == INVALID_PROXY; }
+        };
+
+        struct Proxy {
+            BoundingBox bounds;
+            uint32_t userData = 0;
+            uint32_t node = INVALID_PROXY;
+        };
+
+        uint32_t AllocateNode();
+        void FreeNode(uint32_t node);
+        void InsertLeaf(uint32_t leaf);
+        void RemoveLeaf(uint32_t leaf);
+        void RefitAncestors(uint32_t node);
+        void RefitAll();
+        uint32_t Build(std::vector<uint32_t> &proxies, size_t begin, size_t end, uint32_t parent);
+        void CollectLeaves(uint32_t node, std::vector<uint32_t> &results, std::vector<uint32_t> &stack) const;
+
+        std::vector<Node> _nodes;
+        std::vector<uint32_t> _freeNodes;
+        std::vector<Proxy> _proxies;
+        std::vector<uint32_t> _freeProxies;
+        size_t _proxyCount = 0;
+        uint32_t _root = INVALID_PROXY;
+
+        // moved since the last Commit, may hold proxies removed since
+        std::vector<uint32_t> _movedProxies;
+        // cost right after the last rebuild, which later costs are compared against
+        float _builtCost = 0.0f;
+        // summed surface area of the inner nodes, updated along with their boxes so Cost() needs no walk. Recomputed
+        // by full refits and rebuilds, which drops the rounding errors that add up.
+        float _innerArea = 0.0f;
+    };
+} // namespace IC
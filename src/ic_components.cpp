@@ -2,82 +2,155 @@
 
 #include "ic_log.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
 #include <imgui_stdlib.h>
-#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <cmath>
 
 namespace IC {
     Component::Component() {}
 
     Component::~Component() {}
 
+    void Component::MarkChanged() {
+        if (!_changed) {
+            _changed = true;
+            if (_changedCallback) {
+                _changedCallback();
+            }
+        }
+    }
+
     Transform::Transform() {}
 
     Transform::~Transform() {}
 
-    void Transform::Gui() {
-        ImGui::SeparatorText("TRANSFORM");
-        ImGui::DragFloat3("Position", (float *)&position, 0.01);
-        ImGui::DragFloat3("Rotation", (float *)&rotation);
-        ImGui::DragFloat3("Scale", (float *)&scale);
+    void Transform::SetPosition(const glm::vec3 &position) {
+        _position = position;
+        MarkChanged();
     }
 
-    Mesh::Mesh() {
-        LoadMesh();
+    void Transform::SetRotation(const glm::vec3 &rotation) {
+        _rotation = rotation;
+        MarkChanged();
     }
 
-    Mesh::~Mesh() {}
-
-    void Mesh::LoadMesh() {
-        _vertices.clear();
-        _indices.clear();
+    void Transform::SetScale(const glm::vec3 &scale) {
+        _scale = scale;
+        MarkChanged();
+    }
 
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn, err;
+    glm::mat4 Transform::ModelMatrix() const {
+        glm::quat orientation = glm::quat(glm::radians(_rotation));
+        return glm::translate(glm::mat4(1.0f), _position) * glm::toMat4(orientation) *
+               glm::scale(glm::mat4(1.0f), _scale);
+    }
 
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, _filename.c_str())) {
-            IC_CORE_ERROR("Failed to load {0}.", _filename);
+    void Transform::Gui() {
+        ImGui::SeparatorText("TRANSFORM");
+        bool changed = ImGui::DragFloat3("Position", (float *)&_position, 0.01);
+        changed |= ImGui::DragFloat3("Rotation", (float *)&_rotation);
+        changed |= ImGui::DragFloat3("Scale", (float *)&_scale);
+        if (changed) {
+            MarkChanged();
         }
+    }
 
-        std::unordered_map<VertexData, uint32_t> uniqueVertices{};
-
-        for (const auto &shape : shapes) {
-            for (const auto &index : shape.mesh.indices) {
-                VertexData vertex{};
+    Mesh::Mesh() {
+        LoadMeshAsync();
+    }
 
-                vertex.pos = {attrib.vertices[3 * index.vertex_index + 0], attrib.vertices[3 * index.vertex_index + 1],
-                              attrib.vertices[3 * index.vertex_index + 2]};
+    Mesh::~Mesh() {
+        if (_asset != nullptr) {
+            _asset->RemoveResidencyRequest(_residency);
+        }
+        if (_pendingAsset != nullptr) {
+            _pendingAsset->RemoveResidencyRequest(_residency);
+        }
+    }
 
-                vertex.normal = {attrib.normals[3 * index.normal_index + 0], attrib.normals[3 * index.normal_index + 1],
-                                 attrib.normals[3 * index.normal_index + 2]};
+    MeshLoadHandle Mesh::LoadMeshAsync() {
+        if (_pendingAsset != nullptr) {
+            _pendingAsset->RemoveResidencyRequest(_residency);
+        }
+        _pendingAsset = MeshAssetCache::Acquire(_filename);
+        _pendingAsset->AddResidencyRequest(_residency);
+        // loading the bound file again re-reads it from disk
+        if (_pendingAsset == _asset && !_pendingAsset->IsLoading()) {
+            _pendingAsset->Reload();
+        }
+        return _pendingAsset->LoadHandle();
+    }
 
-                vertex.texCoord = {attrib.texcoords[2 * index.texcoord_index + 0],
-                                   1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+    void Mesh::SetResidency(MeshResidency residency) {
+        for (auto &asset : {_asset, _pendingAsset}) {
+            if (asset != nullptr) {
+                asset->RemoveResidencyRequest(_residency);
+                asset->AddResidencyRequest(residency);
+            }
+        }
+        _residency = residency;
 
-                vertex.color = {1.0f, 1.0f, 1.0f};
+        // data that is not on the gpu yet gets streamed back in by the renderer, so this is always safe
+        if (_asset != nullptr) {
+            _asset->ApplyResidency();
+        }
+    }
 
-                if (uniqueVertices.count(vertex) == 0) {
-                    uniqueVertices[vertex] = static_cast<uint32_t>(_vertices.size());
-                    _vertices.push_back(vertex);
+    bool Mesh::PollLoad() {
+        bool switched = false;
+        if (_pendingAsset != nullptr) {
+            _pendingAsset->PollLoad();
+            if (!_pendingAsset->IsLoading()) {
+                // keep the current geometry if the new file failed to load
+                switched = _pendingAsset->IsLoaded();
+                if (switched) {
+                    if (_asset != nullptr) {
+                        _asset->RemoveResidencyRequest(_residency);
+                    }
+                    _asset = std::move(_pendingAsset);
+                } else {
+                    _pendingAsset->RemoveResidencyRequest(_residency);
                 }
-
-                _indices.push_back(uniqueVertices[vertex]);
+                _pendingAsset = nullptr;
             }
         }
 
-        _vertexCount = static_cast<uint32_t>(_vertices.size());
-        _indexCount = static_cast<uint32_t>(_indices.size());
+        if (_asset != nullptr) {
+            _asset->PollLoad();
+            // the asset may also have been reloaded through another mesh sharing it
+            if (switched || _asset->Version() != _boundsVersion) {
+                _boundsVersion = _asset->Version();
+                MarkChanged();
+            }
+        }
+        return switched;
+    }
 
-        _meshUpdatedFlag = true;
+    MeshData &Mesh::MeshDataOrEmpty() {
+        static MeshData empty{};
+        return _asset != nullptr && _asset->HasCpuData() ? *_asset->Data() : empty;
     }
 
     void Mesh::Gui() {
         ImGui::SeparatorText("MESH");
         ImGui::InputText("File Name", &_filename);
         if (ImGui::Button("Load Mesh")) {
-            LoadMesh();
+            LoadMeshAsync();
+        }
+        if (IsLoading()) {
+            ImGui::SameLine();
+            ImGui::Text("Loading...");
+        }
+
+        const char *residencyNames[] = {"Keep All", "Positions Only", "GPU Only"};
+        int residency = static_cast<int>(_residency);
+        if (ImGui::Combo("CPU Residency", &residency, residencyNames, IM_ARRAYSIZE(residencyNames))) {
+            SetResidency(static_cast<MeshResidency>(residency));
         }
+        ImGui::Checkbox("Occluder", &_occluder);
     }
 
     PointLight::PointLight() {}
@@ -95,6 +168,22 @@ namespace IC {
 
     DirectionalLight::~DirectionalLight() {}
 
+    float PointLight::Range() {
+        const float cutoff = 256.0f;
+        if (_constant >= cutoff) {
+            return 0.0f;
+        }
+        float range = MAX_RANGE;
+        if (_quadratic > 0.0f) {
+            // positive root of quadratic * d^2 + linear * d + constant = cutoff
+            float discriminant = _linear * _linear - 4.0f * _quadratic * (_constant - cutoff);
+            range = (-_linear + std::sqrt(std::max(discriminant, 0.0f))) / (2.0f * _quadratic);
+        } else if (_linear > 0.0f) {
+            range = (cutoff - _constant) / _linear;
+        }
+        return std::clamp(range, 0.0f, MAX_RANGE);
+    }
+
     void DirectionalLight::Gui() {
         ImGui::SeparatorText("DIRECTIONAL LIGHT");
         ImGui::DragFloat3("Light Direction", (float *)&direction);
@@ -0,0 +1,169 @@
+#include "ic_culling.h"
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <xmmintrin.h>
+#define IC_CULLING_SSE
+#endif
+
+namespace IC {
+    namespace {
+        glm::vec4 Row(const glm::mat4 &matrix, int row) {
+            return {matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]};
+        }
+
+        glm::vec4 NormalizePlane(const glm::vec4 &plane) { return plane / glm::length(glm::vec3(plane)); }
+
+        float PlaneDistance(const glm::vec4 &plane, const glm::vec3 &point) {
+            return glm::dot(glm::vec3(plane), point) + plane.w;
+        }
+    } // namespace
+
+    Frustum Frustum::FromMatrix(const glm::mat4 &viewProjection) {
+        glm::vec4 x = Row(viewProjection, 0);
+        glm::vec4 y = Row(viewProjection, 1);
+        glm::vec4 z = Row(viewProjection, 2);
+        glm::vec4 w = Row(viewProjection, 3);
+
+        // the near plane assumes a -w..w depth range, which is conservative for a 0..w range as well
+        Frustum frustum{};
+        frustum.planes[0] = NormalizePlane(w + x);
+        frustum.planes[1] = NormalizePlane(w - x);
+        frustum.planes[2] = NormalizePlane(w + y);
+        frustum.planes[3] = NormalizePlane(w - y);
+        frustum.planes[4] = NormalizePlane(w + z);
+        frustum.planes[5] = NormalizePlane(w - z);
+        return frustum;
+    }
+
+    bool Frustum::Intersects(const BoundingBox &bounds) const {
+        glm::vec3 center = bounds.Center();
+        glm::vec3 extents = bounds.Extents();
+        for (const glm::vec4 &plane : planes) {
+            if (PlaneDistance(plane, center) + glm::dot(glm::abs(glm::vec3(plane)), extents) < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Frustum::Intersects(const BoundingSphere &sphere) const {
+        for (const glm::vec4 &plane : planes) {
+            if (PlaneDistance(plane, sphere.center) + sphere.radius < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Containment Frustum::Classify(const BoundingBox &bounds) const {
+        glm::vec3 center = bounds.Center();
+        glm::vec3 extents = bounds.Extents();
+        Containment containment = Containment::Inside;
+        for (const glm::vec4 &plane : planes) {
+            float distance = PlaneDistance(plane, center);
+            float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+            if (distance + radius < 0.0f) {
+                return Containment::Outside;
+            }
+            if (distance - radius < 0.0f) {
+                containment = Containment::Intersects;
+            }
+        }
+        return containment;
+    }
+
+    void CullingBatch::Clear() {
+        _size = 0;
+        for (std::vector<float> *values : {&_centerX, &_centerY, &_centerZ, &_extentX, &_extentY, &_extentZ,
+                                           &_sphereX, &_sphereY, &_sphereZ, &_radius}) {
+            values->clear();
+        }
+    }
+
+    void CullingBatch::Reserve(size_t count) {
+        for (std::vector<float> *values : {&_centerX, &_centerY, &_centerZ, &_extentX, &_extentY, &_extentZ,
+                                           &_sphereX, &_sphereY, &_sphereZ, &_radius}) {
+            values->reserve(count);
+        }
+    }
+
+    uint32_t CullingBatch::Add(const BoundingBox &bounds, const BoundingSphere &sphere) {
+        glm::vec3 center = bounds.Center();
+        glm::vec3 extents = bounds.Extents();
+        _centerX.push_back(center.x);
+        _centerY.push_back(center.y);
+        _centerZ.push_back(center.z);
+        _extentX.push_back(extents.x);
+        _extentY.push_back(extents.y);
+        _extentZ.push_back(extents.z);
+        _sphereX.push_back(sphere.center.x);
+        _sphereY.push_back(sphere.center.y);
+        _sphereZ.push_back(sphere.center.z);
+        _radius.push_back(sphere.radius);
+        return static_cast<uint32_t>(_size++);
+    }
+
+    void CullingBatch::Cull(const Frustum &frustum, std::vector<uint8_t> &visible) {
+        visible.resize(_size);
+        size_t i = 0;
+
+#ifdef IC_CULLING_SSE
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 zero = _mm_setzero_ps();
+        for (; i + 4 <= _size; i += 4) {
+            __m128 centerX = _mm_loadu_ps(&_centerX[i]);
+            __m128 centerY = _mm_loadu_ps(&_centerY[i]);
+            __m128 centerZ = _mm_loadu_ps(&_centerZ[i]);
+            __m128 extentX = _mm_loadu_ps(&_extentX[i]);
+            __m128 extentY = _mm_loadu_ps(&_extentY[i]);
+            __m128 extentZ = _mm_loadu_ps(&_extentZ[i]);
+            __m128 sphereX = _mm_loadu_ps(&_sphereX[i]);
+            __m128 sphereY = _mm_loadu_ps(&_sphereY[i]);
+            __m128 sphereZ = _mm_loadu_ps(&_sphereZ[i]);
+            __m128 radius = _mm_loadu_ps(&_radius[i]);
+
+            __m128 outside = _mm_setzero_ps();
+            for (const glm::vec4 &plane : frustum.planes) {
+                __m128 planeX = _mm_set1_ps(plane.x);
+                __m128 planeY = _mm_set1_ps(plane.y);
+                __m128 planeZ = _mm_set1_ps(plane.z);
+                __m128 planeW = _mm_set1_ps(plane.w);
+
+                // box: distance of the center plus the extents projected onto the plane normal
+                __m128 boxDistance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(planeX, centerX), _mm_mul_ps(planeY, centerY)),
+                    _mm_add_ps(_mm_mul_ps(planeZ, centerZ), planeW));
+                __m128 boxRadius = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, planeX), extentX),
+                               _mm_mul_ps(_mm_andnot_ps(signMask, planeY), extentY)),
+                    _mm_mul_ps(_mm_andnot_ps(signMask, planeZ), extentZ));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(boxDistance, boxRadius), zero));
+
+                __m128 sphereDistance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(planeX, sphereX), _mm_mul_ps(planeY, sphereY)),
+                    _mm_add_ps(_mm_mul_ps(planeZ, sphereZ), planeW));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(sphereDistance, radius), zero));
+            }
+
+            int outsideMask = _mm_movemask_ps(outside);
+            for (size_t lane = 0; lane < 4; lane++) {
+                visible[i + lane] = ((outsideMask >> lane) & 1) == 0;
+            }
+        }
+#endif
+
+        CullScalar(frustum, i, visible);
+    }
+
+    void CullingBatch::CullScalar(const Frustum &frustum, size_t begin, std::vector<uint8_t> &visible) {
+        for (size_t i = begin; i < _size; i++) {
+            BoundingBox bounds{};
+            glm::vec3 center{_centerX[i], _centerY[i], _centerZ[i]};
+            glm::vec3 extents{_extentX[i], _extentY[i], _extentZ[i]};
+            bounds.min = center - extents;
+            bounds.max = center + extents;
+            BoundingSphere sphere{{_sphereX[i], _sphereY[i], _sphereZ[i]}, _radius[i]};
+            visible[i] = frustum.Intersects(sphere) && frustum.Intersects(bounds);
+        }
+    }
+} // namespace IC
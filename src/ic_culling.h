@@ -0,0 +1,45 @@
+#pragma once
+
+#include <ic_graphics.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace IC {
+    enum class Containment { Outside, Intersects, Inside };
+
+    // Six planes facing into the view volume, with dot(plane.xyz, p) + plane.w >= 0 for points inside.
+    struct Frustum {
+        glm::vec4 planes[6];
+
+        static Frustum FromMatrix(const glm::mat4 &viewProjection);
+
+        bool Intersects(const BoundingBox &bounds) const;
+        bool Intersects(const BoundingSphere &sphere) const;
+        Containment Classify(const BoundingBox &bounds) const;
+    };
+
+    // World bounds of many objects stored as structure of arrays, so they can be tested four at a time with SSE.
+    // Bounds are conservative: an object is culled only if its sphere or its box lies fully outside one plane.
+    class CullingBatch {
+    public:
+        void Clear();
+        void Reserve(size_t count);
+        // Returns the index of the object within the batch.
+        uint32_t Add(const BoundingBox &bounds, const BoundingSphere &sphere);
+        size_t Size() { return _size; }
+
+        // Sets visible[i] to 1 if object i may be inside the frustum, 0 otherwise.
+        void Cull(const Frustum &frustum, std::vector<uint8_t> &visible);
+
+    private:
+        void CullScalar(const Frustum &frustum, size_t begin, std::vector<uint8_t> &visible);
+
+        size_t _size = 0;
+        std::vector<float> _centerX, _centerY, _centerZ;
+        std::vector<float> _extentX, _extentY, _extentZ;
+        std::vector<float> _sphereX, _sphereY, _sphereZ, _radius;
+    };
+} // namespace IC
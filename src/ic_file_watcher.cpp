@@ -0,0 +1,175 @@
+#include "ic_file_watcher.h"
+
+#include <ic_log.h>
+
+#include <unordered_set>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace IC {
+    namespace {
+        // how often modification times are compared when inotify is not available
+        constexpr std::chrono::milliseconds SCAN_INTERVAL{500};
+    } // namespace
+
+    FileWatcher::FileWatcher() {
+#ifdef __linux__
+        _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_inotifyFd < 0) {
+            IC_CORE_WARN("inotify unavailable, falling back to polling for file changes.");
+        }
+#endif
+    }
+
+    FileWatcher::~FileWatcher() {
+#ifdef __linux__
+        if (_inotifyFd >= 0) {
+            close(_inotifyFd);
+        }
+#endif
+    }
+
+    void FileWatcher::Watch(const std::string &path, Func<void, const std::string &> callback) {
+        std::string key = NormalizePath(path);
+
+        auto it = _files.find(key);
+        if (it != _files.end()) {
+            it->second.callback = callback;
+            return;
+        }
+
+        std::string directory = std::filesystem::path(key).parent_path().generic_string();
+        if (directory.empty()) {
+            directory = ".";
+        }
+
+        _files[key] = WatchedFile{.path = path, .directory = directory, .callback = callback,
+                                  .lastWriteTime = LastWriteTime(key)};
+        if (_directoryRefs[directory]++ == 0) {
+            AddDirectoryWatch(directory);
+        }
+    }
+
+    void FileWatcher::Unwatch(const std::string &path) {
+        auto it = _files.find(NormalizePath(path));
+        if (it == _files.end()) {
+            return;
+        }
+
+        std::string directory = it->second.directory;
+        _files.erase(it);
+        if (--_directoryRefs[directory] == 0) {
+            _directoryRefs.erase(directory);
+            RemoveDirectoryWatch(directory);
+        }
+    }
+
+    bool FileWatcher::IsWatching(const std::string &path) {
+        return _files.contains(NormalizePath(path));
+    }
+
+    void FileWatcher::Poll() {
+        std::unordered_set<std::string> changed;
+
+#ifdef __linux__
+        if (_inotifyFd >= 0) {
+            alignas(inotify_event) char buffer[4096];
+            while (true) {
+                ssize_t length = read(_inotifyFd, buffer, sizeof(buffer));
+                if (length <= 0) {
+                    break;
+                }
+
+                for (char *ptr = buffer; ptr < buffer + length;) {
+                    auto *event = reinterpret_cast<inotify_event *>(ptr);
+                    ptr += sizeof(inotify_event) + event->len;
+
+                    auto directory = _watchDirectories.find(event->wd);
+                    if (event->len == 0 || directory == _watchDirectories.end()) {
+                        continue;
+                    }
+
+                    std::string key = NormalizePath(directory->second + "/" + event->name);
+                    if (_files.contains(key)) {
+                        changed.insert(key);
+                    }
+                }
+            }
+        } else
+#endif
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (now - _lastScan < SCAN_INTERVAL) {
+                return;
+            }
+            _lastScan = now;
+
+            for (auto &[key, file] : _files) {
+                std::filesystem::file_time_type writeTime = LastWriteTime(key);
+                if (writeTime != file.lastWriteTime) {
+                    file.lastWriteTime = writeTime;
+                    changed.insert(key);
+                }
+            }
+        }
+
+        // copy callbacks out first, they are allowed to watch and unwatch files
+        std::vector<std::pair<std::string, Func<void, const std::string &>>> callbacks;
+        for (const std::string &key : changed) {
+            auto it = _files.find(key);
+            if (it != _files.end()) {
+                callbacks.emplace_back(it->second.path, it->second.callback);
+            }
+        }
+
+        for (auto &[path, callback] : callbacks) {
+            IC_CORE_INFO("Reloading {0}.", path);
+            callback(path);
+        }
+    }
+
+    std::string FileWatcher::NormalizePath(const std::string &path) {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+
+    std::filesystem::file_time_type FileWatcher::LastWriteTime(const std::string &path) {
+        std::error_code error;
+        std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path, error);
+        return error ? std::filesystem::file_time_type{} : writeTime;
+    }
+
+    void FileWatcher::AddDirectoryWatch(const std::string &directory) {
+#ifdef __linux__
+        if (_inotifyFd < 0) {
+            return;
+        }
+
+        // watch the directory rather than the file, editors and build tools often replace files by renaming
+        int wd = inotify_add_watch(_inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+            IC_CORE_WARN("Failed to watch directory {0} ({1}).", directory, errno);
+            return;
+        }
+        _watchDirectories[wd] = directory;
+        _directoryWatches[directory] = wd;
+#endif
+    }
+
+    void FileWatcher::RemoveDirectoryWatch(const std::string &directory) {
+#ifdef __linux__
+        auto it = _directoryWatches.find(directory);
+        if (it == _directoryWatches.end()) {
+            return;
+        }
+
+        inotify_rm_watch(_inotifyFd, it->second);
+        _watchDirectories.erase(it->second);
+        _directoryWatches.erase(it);
+#endif
+    }
+} // namespace IC
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <ic_common.h>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+namespace IC {
+    // Watches files for changes. Uses inotify on Linux and falls back to polling modification times elsewhere.
+    // Callbacks run on the thread that calls Poll, so callers can pick a safe point such as a frame boundary.
+    class FileWatcher {
+    public:
+        FileWatcher();
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher &) = delete;
+        FileWatcher &operator=(const FileWatcher &) = delete;
+
+        // Watches a file. A path has a single callback; watching it again replaces the previous one.
+        void Watch(const std::string &path, Func<void, const std::string &> callback);
+        void Unwatch(const std::string &path);
+        bool IsWatching(const std::string &path);
+
+        // Runs the callback of every watched file that changed since the last call. Several writes to the same
+        // file between two polls trigger a single callback.
+        void Poll();
+
+    private:
+        struct WatchedFile {
+            std::string path;
+            std::string directory;
+            Func<void, const std::string &> callback;
+            std::filesystem::file_time_type lastWriteTime;
+        };
+
+        static std::string NormalizePath(const std::string &path);
+        static std::filesystem::file_time_type LastWriteTime(const std::string &path);
+
+        void AddDirectoryWatch(const std::string &directory);
+        void RemoveDirectoryWatch(const std::string &directory);
+
+        std::unordered_map<std::string, WatchedFile> _files;
+
+        // number of watched files per directory
+        std::unordered_map<std::string, uint32_t> _directoryRefs;
+
+#ifdef __linux__
+        int _inotifyFd = -1;
+        std::unordered_map<int, std::string> _watchDirectories;
+        std::unordered_map<std::string, int> _directoryWatches;
+#endif
+        std::chrono::steady_clock::time_point _lastScan{};
+    };
+} // namespace IC
@@ -4,4 +4,113 @@
 
 #include <tiny_obj_loader.h>
 
-namespace IC {} // namespace IC
+#include <algorithm>
+#include <unordered_map>
+
+namespace IC {
+    std::shared_ptr<MeshData> LoadMeshData(const std::string &filename) {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
+            IC_CORE_ERROR("Failed to load {0}.", filename);
+            return nullptr;
+        }
+
+        auto meshData = std::make_shared<MeshData>();
+        std::unordered_map<VertexData, uint32_t> uniqueVertices{};
+
+        for (const auto &shape : shapes) {
+            for (const auto &index : shape.mesh.indices) {
+                VertexData vertex{};
+
+                vertex.pos = {attrib.vertices[3 * index.vertex_index + 0], attrib.vertices[3 * index.vertex_index + 1],
+                              attrib.vertices[3 * index.vertex_index + 2]};
+
+                vertex.normal = {attrib.normals[3 * index.normal_index + 0], attrib.normals[3 * index.normal_index + 1],
+                                 attrib.normals[3 * index.normal_index + 2]};
+
+                vertex.texCoord = {attrib.texcoords[2 * index.texcoord_index + 0],
+                                   1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+
+                vertex.color = {1.0f, 1.0f, 1.0f};
+
+                if (uniqueVertices.count(vertex) == 0) {
+                    uniqueVertices[vertex] = static_cast<uint32_t>(meshData->vertices.size());
+                    meshData->vertices.push_back(vertex);
+                }
+
+                meshData->indices.push_back(uniqueVertices[vertex]);
+            }
+        }
+
+        ComputeBounds(*meshData);
+        return meshData;
+    }
+
+    std::shared_ptr<MeshData> CreatePlaceholderMeshData() {
+        // face normal, then two edge directions whose cross product is the normal (counter-clockwise winding)
+        const glm::vec3 faces[6][3] = {
+            {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}},  {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+            {{0, 1, 0}, {0, 0, 1}, {1, 0, 0}},  {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+            {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},  {{0, 0, -1}, {0, 1, 0}, {1, 0, 0}},
+        };
+        const glm::vec2 corners[4] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+
+        auto meshData = std::make_shared<MeshData>();
+        for (const auto &face : faces) {
+            uint32_t first = static_cast<uint32_t>(meshData->vertices.size());
+            for (const glm::vec2 &corner : corners) {
+                VertexData vertex{};
+                vertex.pos = 0.5f * (face[0] + corner.x * face[1] + corner.y * face[2]);
+                vertex.normal = face[0];
+                vertex.color = {1.0f, 1.0f, 1.0f};
+                vertex.texCoord = 0.5f * (corner + glm::vec2(1.0f));
+                meshData->vertices.push_back(vertex);
+            }
+            meshData->indices.insert(meshData->indices.end(),
+                                     {first, first + 1, first + 2, first, first + 2, first + 3});
+        }
+        ComputeBounds(*meshData);
+        return meshData;
+    }
+
+    void ComputeBounds(MeshData &meshData) {
+        if (meshData.vertices.empty()) {
+            meshData.bounds = {};
+            meshData.sphere = {};
+            return;
+        }
+
+        BoundingBox bounds{meshData.vertices[0].pos, meshData.vertices[0].pos};
+        for (const VertexData &vertex : meshData.vertices) {
+            bounds.min = glm::min(bounds.min, vertex.pos);
+            bounds.max = glm::max(bounds.max, vertex.pos);
+        }
+
+        BoundingSphere sphere{bounds.Center(), 0.0f};
+        for (const VertexData &vertex : meshData.vertices) {
+            sphere.radius = std::max(sphere.radius, glm::distance(sphere.center, vertex.pos));
+        }
+
+        meshData.bounds = bounds;
+        meshData.sphere = sphere;
+    }
+
+    BoundingBox TransformBounds(const BoundingBox &bounds, const glm::mat4 &transform) {
+        // the extents along each world axis are the sum of the absolute projections of the local extents
+        glm::mat3 absolute{glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])),
+                           glm::abs(glm::vec3(transform[2]))};
+        glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.Center(), 1.0f));
+        glm::vec3 extents = absolute * bounds.Extents();
+        return {center - extents, center + extents};
+    }
+
+    BoundingSphere TransformBounds(const BoundingSphere &sphere, const glm::mat4 &transform) {
+        float scale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                                glm::length(glm::vec3(transform[2]))});
+        return {glm::vec3(transform * glm::vec4(sphere.center, 1.0f)), sphere.radius * scale};
+    }
+} // namespace IC
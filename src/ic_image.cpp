@@ -0,0 +1,83 @@
+#include "ic_image.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace IC {
+    namespace {
+        constexpr uint32_t ENCODE_STEPS = 4096;
+
+        struct SrgbTables {
+            // linear value of every 8 bit sRGB value
+            std::array<float, 256> toLinear;
+            // linear values halfway between consecutive sRGB values, the encoded value is the number of them below
+            std::array<float, 255> encodeThresholds;
+            // number of thresholds below each of ENCODE_STEPS evenly spaced linear values, where the search starts
+            std::array<uint8_t, ENCODE_STEPS + 1> encodeStart;
+        };
+
+        float DecodeSrgb(float c) {
+            return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        const SrgbTables &Tables() {
+            static const SrgbTables tables = []() {
+                SrgbTables result;
+                for (uint32_t i = 0; i < result.toLinear.size(); i++) {
+                    result.toLinear[i] = DecodeSrgb(i / 255.0f);
+                }
+                for (uint32_t i = 0; i < result.encodeThresholds.size(); i++) {
+                    result.encodeThresholds[i] = DecodeSrgb((i + 0.5f) / 255.0f);
+                }
+                for (uint32_t i = 0; i <= ENCODE_STEPS; i++) {
+                    float value = static_cast<float>(i) / ENCODE_STEPS;
+                    result.encodeStart[i] = static_cast<uint8_t>(
+                        std::upper_bound(result.encodeThresholds.begin(), result.encodeThresholds.end(), value) -
+                        result.encodeThresholds.begin());
+                }
+                return result;
+            }();
+            return tables;
+        }
+
+        uint8_t LinearToSrgb(const SrgbTables &tables, float value) {
+            uint32_t encoded = tables.encodeStart[static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * ENCODE_STEPS)];
+            while (encoded < tables.encodeThresholds.size() && value >= tables.encodeThresholds[encoded]) {
+                encoded++;
+            }
+            return static_cast<uint8_t>(encoded);
+        }
+    } // namespace
+
+    std::vector<uint8_t> DownsampleRGBA8(const uint8_t *pixels, uint32_t width, uint32_t height, bool srgb) {
+        uint32_t resultWidth = std::max(1u, width / 2);
+        uint32_t resultHeight = std::max(1u, height / 2);
+        std::vector<uint8_t> result(resultWidth * resultHeight * 4);
+
+        // the transfer function is looked up rather than evaluated, it would otherwise dominate large images
+        const SrgbTables &tables = Tables();
+        for (uint32_t y = 0; y < resultHeight; y++) {
+            const uint8_t *rows[2] = {pixels + size_t(std::min(y * 2, height - 1)) * width * 4,
+                                      pixels + size_t(std::min(y * 2 + 1, height - 1)) * width * 4};
+            for (uint32_t x = 0; x < resultWidth; x++) {
+                uint32_t columns[2] = {std::min(x * 2, width - 1) * 4, std::min(x * 2 + 1, width - 1) * 4};
+                uint8_t *target = result.data() + (size_t(y) * resultWidth + x) * 4;
+                for (uint32_t c = 0; c < 4; c++) {
+                    uint8_t texels[4] = {rows[0][columns[0] + c], rows[0][columns[1] + c], rows[1][columns[0] + c],
+                                         rows[1][columns[1] + c]};
+                    if (srgb && c < 3) {
+                        float sum = tables.toLinear[texels[0]] + tables.toLinear[texels[1]] +
+                                    tables.toLinear[texels[2]] + tables.toLinear[texels[3]];
+                        target[c] = LinearToSrgb(tables, sum / 4.0f);
+                    } else {
+                        // alpha and linear data round half up, like the float average did
+                        target[c] = static_cast<uint8_t>((texels[0] + texels[1] + texels[2] + texels[3] + 2) / 4);
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+} // namespace IC
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace IC {
+    // 2x2 box filter of an RGBA8 image into the next mip level. sRGB encoded color channels are averaged in linear
+    // space, alpha is always linear.
+    std::vector<uint8_t> DownsampleRGBA8(const uint8_t *pixels, uint32_t width, uint32_t height, bool srgb);
+} // namespace IC
@@ -0,0 +1,75 @@
+#include "ic_job_system.h"
+
+#include <ic_log.h>
+
+#include <algorithm>
+
+namespace IC {
+    std::vector<std::thread> JobSystem::_workers;
+    std::queue<Func<void>> JobSystem::_jobs;
+    std::mutex JobSystem::_mutex;
+    std::condition_variable JobSystem::_condition;
+    bool JobSystem::_stopping = false;
+
+    void JobSystem::Init(uint32_t threadCount) {
+        if (!_workers.empty()) {
+            return;
+        }
+
+        if (threadCount == 0) {
+            threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        }
+
+        _stopping = false;
+        for (uint32_t i = 0; i < threadCount; i++) {
+            _workers.emplace_back(&JobSystem::WorkerLoop);
+        }
+
+        IC_CORE_INFO("Job system started with {0} worker threads.", threadCount);
+    }
+
+    void JobSystem::Shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _condition.notify_all();
+
+        for (std::thread &worker : _workers) {
+            worker.join();
+        }
+        _workers.clear();
+    }
+
+    void JobSystem::Schedule(Func<void> job) {
+        if (_workers.empty()) {
+            job();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _jobs.push(std::move(job));
+        }
+        _condition.notify_one();
+    }
+
+    void JobSystem::WorkerLoop() {
+        while (true) {
+            Func<void> job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condition.wait(lock, []() { return _stopping || !_jobs.empty(); });
+
+                // keep draining the queue on shutdown so no submitted future is left unfulfilled
+                if (_jobs.empty()) {
+                    return;
+                }
+
+                job = std::move(_jobs.front());
+                _jobs.pop();
+            }
+            job();
+        }
+    }
+} // namespace IC
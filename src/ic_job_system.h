@@ -0,0 +1,49 @@
+#pragma once
+
+#include <ic_common.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace IC {
+    // Pool of worker threads that runs queued jobs in submission order.
+    class JobSystem {
+    public:
+        // Starts the worker threads. A thread count of 0 uses all but one of the hardware threads.
+        static void Init(uint32_t threadCount = 0);
+
+        // Finishes all queued jobs, then joins the worker threads.
+        static void Shutdown();
+
+        // Queues a job. If the pool has not been started the job runs immediately on the calling thread.
+        static void Schedule(Func<void> job);
+
+        // Queues a job and returns a future holding its result.
+        template <typename F> static auto Submit(F &&job) -> std::future<std::invoke_result_t<F>> {
+            using Result = std::invoke_result_t<F>;
+
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+            std::future<Result> future = task->get_future();
+            Schedule([task]() { (*task)(); });
+            return future;
+        }
+
+        static size_t WorkerCount() { return _workers.size(); }
+
+    private:
+        static void WorkerLoop();
+
+        static std::vector<std::thread> _workers;
+        static std::queue<Func<void>> _jobs;
+        static std::mutex _mutex;
+        static std::condition_variable _condition;
+        static bool _stopping;
+    };
+} // namespace IC
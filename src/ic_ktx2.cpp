@@ -0,0 +1,306 @@
+#include "ic_ktx2.h"
+
+#include <ic_log.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace IC {
+    namespace {
+        constexpr uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                                                 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+        constexpr size_t HEADER_SIZE = 80;
+        constexpr size_t LEVEL_INDEX_ENTRY_SIZE = 24;
+
+        // data format descriptor constants, see the Khronos Data Format specification
+        constexpr uint8_t KHR_DF_MODEL_RGBSDA = 1;
+        constexpr uint8_t KHR_DF_MODEL_BC1A = 128;
+        constexpr uint8_t KHR_DF_MODEL_BC4 = 131;
+        constexpr uint8_t KHR_DF_MODEL_BC5 = 132;
+        constexpr uint8_t KHR_DF_MODEL_BC7 = 134;
+        constexpr uint8_t KHR_DF_PRIMARIES_BT709 = 1;
+        constexpr uint8_t KHR_DF_TRANSFER_LINEAR = 1;
+        constexpr uint8_t KHR_DF_TRANSFER_SRGB = 2;
+
+        struct ByteReader {
+            const std::vector<uint8_t> &bytes;
+            size_t offset;
+
+            template <typename T> T Read() {
+                T value{};
+                memcpy(&value, bytes.data() + offset, sizeof(T));
+                offset += sizeof(T);
+                return value;
+            }
+        };
+
+        template <typename T> void Append(std::vector<uint8_t> &bytes, T value) {
+            const auto *data = reinterpret_cast<const uint8_t *>(&value);
+            bytes.insert(bytes.end(), data, data + sizeof(T));
+        }
+
+        bool IsKnownFormat(uint32_t vkFormat) {
+            switch (static_cast<Ktx2Format>(vkFormat)) {
+            case Ktx2Format::RGBA8Unorm:
+            case Ktx2Format::RGBA8Srgb:
+            case Ktx2Format::BC1RGBUnorm:
+            case Ktx2Format::BC1RGBSrgb:
+            case Ktx2Format::BC4Unorm:
+            case Ktx2Format::BC5Unorm:
+            case Ktx2Format::BC7Unorm:
+            case Ktx2Format::BC7Srgb:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        bool IsSrgb(uint32_t vkFormat) {
+            auto format = static_cast<Ktx2Format>(vkFormat);
+            return format == Ktx2Format::RGBA8Srgb || format == Ktx2Format::BC1RGBSrgb ||
+                   format == Ktx2Format::BC7Srgb;
+        }
+
+        // Basic data format descriptor block describing one of the supported formats.
+        std::vector<uint8_t> BuildDataFormatDescriptor(uint32_t vkFormat) {
+            struct Sample {
+                uint16_t bitOffset;
+                uint8_t bitLength;
+                uint8_t channel;
+            };
+
+            uint8_t colorModel = KHR_DF_MODEL_RGBSDA;
+            std::vector<Sample> samples;
+            switch (static_cast<Ktx2Format>(vkFormat)) {
+            case Ktx2Format::BC1RGBUnorm:
+            case Ktx2Format::BC1RGBSrgb:
+                colorModel = KHR_DF_MODEL_BC1A;
+                samples = {{0, 64, 0}};
+                break;
+            case Ktx2Format::BC4Unorm:
+                colorModel = KHR_DF_MODEL_BC4;
+                samples = {{0, 64, 0}};
+                break;
+            case Ktx2Format::BC5Unorm:
+                colorModel = KHR_DF_MODEL_BC5;
+                samples = {{0, 64, 0}, {64, 64, 1}};
+                break;
+            case Ktx2Format::BC7Unorm:
+            case Ktx2Format::BC7Srgb:
+                colorModel = KHR_DF_MODEL_BC7;
+                samples = {{0, 128, 0}};
+                break;
+            default:
+                samples = {{0, 8, 0}, {8, 8, 1}, {16, 8, 2}, {24, 8, 15}};
+                break;
+            }
+
+            bool compressed = Ktx2BlockSize(vkFormat) != 0;
+            uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+            std::vector<uint8_t> descriptor;
+            Append<uint32_t>(descriptor, 4 + blockSize);
+            Append<uint32_t>(descriptor, 0); // khronos vendor, basic descriptor type
+            Append<uint32_t>(descriptor, 2 | (blockSize << 16));
+            Append<uint8_t>(descriptor, colorModel);
+            Append<uint8_t>(descriptor, KHR_DF_PRIMARIES_BT709);
+            Append<uint8_t>(descriptor, IsSrgb(vkFormat) ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR);
+            Append<uint8_t>(descriptor, 0);
+            for (uint8_t dimension : {compressed ? 3 : 0, compressed ? 3 : 0, 0, 0}) {
+                Append<uint8_t>(descriptor, dimension);
+            }
+            Append<uint8_t>(descriptor, static_cast<uint8_t>(compressed ? Ktx2BlockSize(vkFormat) : 4));
+            for (int i = 0; i < 7; i++) {
+                Append<uint8_t>(descriptor, 0);
+            }
+
+            for (const Sample &sample : samples) {
+                // the alpha channel of srgb formats is always linear
+                uint8_t qualifiers = (IsSrgb(vkFormat) && sample.channel == 15) ? 0x10 : 0;
+                Append<uint16_t>(descriptor, sample.bitOffset);
+                Append<uint8_t>(descriptor, sample.bitLength - 1);
+                Append<uint8_t>(descriptor, sample.channel | qualifiers);
+                Append<uint32_t>(descriptor, 0);
+                Append<uint32_t>(descriptor, 0);
+                Append<uint32_t>(descriptor, sample.bitLength >= 32 ? UINT32_MAX : (1u << sample.bitLength) - 1);
+            }
+
+            return descriptor;
+        }
+    } // namespace
+
+    uint32_t Ktx2BlockSize(uint32_t vkFormat) {
+        switch (static_cast<Ktx2Format>(vkFormat)) {
+        case Ktx2Format::BC1RGBUnorm:
+        case Ktx2Format::BC1RGBSrgb:
+        case Ktx2Format::BC4Unorm:
+            return 8;
+        case Ktx2Format::BC5Unorm:
+        case Ktx2Format::BC7Unorm:
+        case Ktx2Format::BC7Srgb:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+
+    uint64_t Ktx2LevelSize(uint32_t vkFormat, uint32_t width, uint32_t height, uint32_t layers) {
+        uint32_t blockSize = Ktx2BlockSize(vkFormat);
+        if (blockSize == 0) {
+            return uint64_t(width) * height * 4 * layers;
+        }
+        return uint64_t((width + 3) / 4) * ((height + 3) / 4) * blockSize * layers;
+    }
+
+    bool ReadKtx2(const std::string &path, Ktx2Texture &texture, uint32_t maxLevelSize) {
+        std::ifstream file{path, std::ios::ate | std::ios::binary};
+        if (!file.is_open()) {
+            IC_CORE_ERROR("Failed to open file {0}.", path);
+            return false;
+        }
+
+        // the header and level index are read first, so skipped levels are never read from disk
+        uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+        std::vector<uint8_t> bytes(HEADER_SIZE);
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+
+        if (!file || memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+            IC_CORE_ERROR("{0} is not a KTX2 file.", path);
+            return false;
+        }
+
+        ByteReader reader{bytes, sizeof(KTX2_IDENTIFIER)};
+        texture.vkFormat = reader.Read<uint32_t>();
+        reader.Read<uint32_t>(); // typeSize
+        texture.width = reader.Read<uint32_t>();
+        texture.height = reader.Read<uint32_t>();
+        uint32_t depth = reader.Read<uint32_t>();
+        uint32_t layerCount = reader.Read<uint32_t>();
+        uint32_t faceCount = reader.Read<uint32_t>();
+        uint32_t levelCount = std::max(1u, reader.Read<uint32_t>());
+        uint32_t supercompression = reader.Read<uint32_t>();
+
+        if (depth > 1 || faceCount != 1 || supercompression != 0) {
+            IC_CORE_ERROR("KTX2 file {0} uses unsupported features (3D, cubemap or supercompression).", path);
+            return false;
+        }
+        if (texture.vkFormat == 0) {
+            IC_CORE_ERROR("KTX2 file {0} has no Vulkan format, Basis Universal textures are not supported.", path);
+            return false;
+        }
+        // level sizes are only known for the formats the converter writes
+        if (!IsKnownFormat(texture.vkFormat)) {
+            IC_CORE_ERROR("KTX2 file {0} uses unsupported format {1}.", path, texture.vkFormat);
+            return false;
+        }
+        if (fileSize < HEADER_SIZE + levelCount * LEVEL_INDEX_ENTRY_SIZE) {
+            IC_CORE_ERROR("KTX2 file {0} is truncated.", path);
+            return false;
+        }
+
+        // 0 marks a texture that is not an array
+        texture.layers = std::max(1u, layerCount);
+
+        bytes.resize(levelCount * LEVEL_INDEX_ENTRY_SIZE);
+        file.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+        reader.offset = 0;
+
+        uint32_t firstLevel = 0;
+        while (firstLevel + 1 < levelCount &&
+               std::max(texture.width >> firstLevel, texture.height >> firstLevel) > maxLevelSize) {
+            firstLevel++;
+        }
+
+        texture.levels.clear();
+        for (uint32_t level = 0; level < levelCount; level++) {
+            uint64_t byteOffset = reader.Read<uint64_t>();
+            uint64_t byteLength = reader.Read<uint64_t>();
+            reader.Read<uint64_t>(); // uncompressedByteLength
+
+            if (byteOffset + byteLength > fileSize) {
+                IC_CORE_ERROR("KTX2 file {0} is truncated.", path);
+                return false;
+            }
+
+            Ktx2Level &mip = texture.levels.emplace_back();
+            mip.width = std::max(1u, texture.width >> level);
+            mip.height = std::max(1u, texture.height >> level);
+            // uploads copy the full extent of every level, so a short level would be read past its end
+            if (byteLength != Ktx2LevelSize(texture.vkFormat, mip.width, mip.height, texture.layers)) {
+                IC_CORE_ERROR("KTX2 file {0} has {1} bytes in level {2}, its extent needs {3}.", path, byteLength,
+                              level, Ktx2LevelSize(texture.vkFormat, mip.width, mip.height, texture.layers));
+                return false;
+            }
+            if (level < firstLevel) {
+                continue;
+            }
+
+            mip.data.resize(byteLength);
+            file.seekg(static_cast<std::streamoff>(byteOffset));
+            file.read(reinterpret_cast<char *>(mip.data.data()), byteLength);
+            if (!file) {
+                IC_CORE_ERROR("Failed to read file {0}.", path);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool WriteKtx2(const std::string &path, const Ktx2Texture &texture) {
+        uint32_t levelCount = static_cast<uint32_t>(texture.levels.size());
+        std::vector<uint8_t> descriptor = BuildDataFormatDescriptor(texture.vkFormat);
+        uint32_t blockSize = Ktx2BlockSize(texture.vkFormat);
+
+        uint32_t dfdOffset = static_cast<uint32_t>(HEADER_SIZE + levelCount * LEVEL_INDEX_ENTRY_SIZE);
+
+        std::vector<uint8_t> bytes(KTX2_IDENTIFIER, KTX2_IDENTIFIER + sizeof(KTX2_IDENTIFIER));
+        Append<uint32_t>(bytes, texture.vkFormat);
+        Append<uint32_t>(bytes, 1); // typeSize, 1 for block compressed and 8 bit formats
+        Append<uint32_t>(bytes, texture.width);
+        Append<uint32_t>(bytes, texture.height);
+        Append<uint32_t>(bytes, 0); // depth
+        Append<uint32_t>(bytes, texture.layers > 1 ? texture.layers : 0);
+        Append<uint32_t>(bytes, 1); // faces
+        Append<uint32_t>(bytes, levelCount);
+        Append<uint32_t>(bytes, 0); // supercompression
+        Append<uint32_t>(bytes, dfdOffset);
+        Append<uint32_t>(bytes, static_cast<uint32_t>(descriptor.size()));
+        Append<uint32_t>(bytes, 0); // key/value data
+        Append<uint32_t>(bytes, 0);
+        Append<uint64_t>(bytes, 0); // supercompression global data
+        Append<uint64_t>(bytes, 0);
+
+        // mip data is stored smallest level first, each level aligned to the texel block size
+        uint64_t alignment = blockSize != 0 ? blockSize : 4;
+        std::vector<uint64_t> offsets(levelCount);
+        uint64_t offset = dfdOffset + descriptor.size();
+        for (uint32_t level = levelCount; level-- > 0;) {
+            offset = (offset + alignment - 1) / alignment * alignment;
+            offsets[level] = offset;
+            offset += texture.levels[level].data.size();
+        }
+
+        for (uint32_t level = 0; level < levelCount; level++) {
+            Append<uint64_t>(bytes, offsets[level]);
+            Append<uint64_t>(bytes, texture.levels[level].data.size());
+            Append<uint64_t>(bytes, texture.levels[level].data.size());
+        }
+        bytes.insert(bytes.end(), descriptor.begin(), descriptor.end());
+
+        for (uint32_t level = levelCount; level-- > 0;) {
+            bytes.resize(offsets[level], 0);
+            bytes.insert(bytes.end(), texture.levels[level].data.begin(), texture.levels[level].data.end());
+        }
+
+        std::ofstream file{path, std::ios::binary};
+        if (!file.is_open()) {
+            IC_CORE_ERROR("Failed to open file {0}.", path);
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+        return file.good();
+    }
+} // namespace IC
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace IC {
+    // Subset of the Vulkan formats written by the texture converter. Values match VkFormat.
+    enum class Ktx2Format : uint32_t {
+        Undefined = 0,
+        RGBA8Unorm = 37,
+        RGBA8Srgb = 43,
+        BC1RGBUnorm = 131,
+        BC1RGBSrgb = 132,
+        BC4Unorm = 139,
+        BC5Unorm = 141,
+        BC7Unorm = 145,
+        BC7Srgb = 146
+    };
+
+    struct Ktx2Level {
+        uint32_t width;
+        uint32_t height;
+        // every layer of the level, one after another. Empty for levels skipped by ReadKtx2.
+        std::vector<uint8_t> data;
+    };
+
+    // Single face, non supercompressed 2D texture or 2D texture array. Level 0 is the full resolution image.
+    struct Ktx2Texture {
+        // VkFormat of the texel data
+        uint32_t vkFormat;
+        uint32_t width;
+        uint32_t height;
+        uint32_t layers = 1;
+        std::vector<Ktx2Level> levels;
+    };
+
+    // Returns false if the file is missing, malformed or uses features other than the above. Only the texels of
+    // levels no larger than maxLevelSize are read, and of the last level if all are larger.
+    bool ReadKtx2(const std::string &path, Ktx2Texture &texture, uint32_t maxLevelSize = UINT32_MAX);
+    bool WriteKtx2(const std::string &path, const Ktx2Texture &texture);
+
+    // Bytes per 4x4 block for block compressed formats, 0 for anything else.
+    uint32_t Ktx2BlockSize(uint32_t vkFormat);
+    // Bytes of one level of the above formats, all layers included.
+    uint64_t Ktx2LevelSize(uint32_t vkFormat, uint32_t width, uint32_t height, uint32_t layers);
+} // namespace IC
@@ -12,6 +12,10 @@ namespace IC {
         _bindings[bindingIndex] = binding;
     }
 
+    void MaterialTemplate::AddVariantKey(uint32_t constantId, std::string name, uint32_t defaultValue) {
+        _variantKeys[constantId] = {constantId, name, defaultValue};
+    }
+
     MaterialInstance::MaterialInstance(MaterialTemplate &materialTemplate) : _template{materialTemplate} {
         // initialize shader binding values
         for (auto &[index, binding] : _template.Bindings()) {
@@ -24,4 +28,16 @@ namespace IC {
         _bindingValues[index].value = value;
         _bindingValues[index].size = size;
     }
+
+    void MaterialInstance::SetVariant(uint32_t constantId, uint32_t value) {
+        _variantValues[constantId] = value;
+    }
+
+    uint32_t MaterialInstance::VariantValue(uint32_t constantId) {
+        auto it = _variantValues.find(constantId);
+        if (it != _variantValues.end()) {
+            return it->second;
+        }
+        return _template.VariantKeys()[constantId].defaultValue;
+    }
 } // namespace IC
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include <ic_mesh_asset.h>
+
+#include "ic_job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+namespace IC {
+    std::mutex MeshAssetCache::_mutex;
+    std::unordered_map<std::string, std::weak_ptr<MeshAsset>> MeshAssetCache::_assets;
+
+    void MeshAsset::LoadAsync() {
+        std::string path = _path;
+        _load = JobSystem::Submit([path]() { return LoadMeshData(path); }).share();
+    }
+
+    void MeshAsset::Reload() {
+        _restreaming = false;
+        _reapplyResidency = false;
+        LoadAsync();
+    }
+
+    bool MeshAsset::PollLoad() {
+        if (!_load.valid() || _load.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+
+        std::shared_ptr<MeshData> data = _load.get();
+        _load = {};
+
+        bool restreamed = _restreaming;
+        _restreaming = false;
+
+        // keep any previous data if the file failed to load
+        if (data == nullptr) {
+            _failed = true;
+            return false;
+        }
+
+        _data = data;
+        _failed = false;
+
+        // restreamed data matches what is already on the gpu, so the version stays the same
+        if (restreamed) {
+            if (_reapplyResidency) {
+                _reapplyResidency = false;
+                ApplyResidency();
+            }
+            return false;
+        }
+
+        _vertexCount = static_cast<uint32_t>(_data->vertices.size());
+        _indexCount = static_cast<uint32_t>(_data->indices.size());
+        _boundingRadius = 0.0f;
+        for (const VertexData &vertex : _data->vertices) {
+            _boundingRadius = std::max(_boundingRadius, glm::length(vertex.pos));
+        }
+        _bounds = _data->bounds;
+        _sphere = _data->sphere;
+        _positions = {};
+        _indices = {};
+        _version++;
+        return true;
+    }
+
+    void MeshAsset::AddResidencyRequest(MeshResidency residency) {
+        _residencyRequests[static_cast<size_t>(residency)]++;
+    }
+
+    void MeshAsset::RemoveResidencyRequest(MeshResidency residency) {
+        uint32_t &count = _residencyRequests[static_cast<size_t>(residency)];
+        if (count > 0) {
+            count--;
+        }
+    }
+
+    MeshResidency MeshAsset::Residency() {
+        for (size_t i = 0; i < static_cast<size_t>(MeshResidency::Count); i++) {
+            if (_residencyRequests[i] > 0) {
+                return static_cast<MeshResidency>(i);
+            }
+        }
+        return MeshResidency::KeepAll;
+    }
+
+    void MeshAsset::ApplyResidency() {
+        if (!IsLoaded()) {
+            return;
+        }
+
+        MeshResidency residency = Residency();
+        if (_data == nullptr) {
+            // a policy keeping more than what is left streams the full data back in, and is applied once it arrives
+            if (residency == MeshResidency::KeepAll ||
+                (residency == MeshResidency::PositionsOnly && _positions.empty() && _vertexCount > 0)) {
+                _reapplyResidency = true;
+                RequestCpuData();
+            } else if (residency == MeshResidency::GpuOnly) {
+                _positions = {};
+                _indices = {};
+            }
+            return;
+        }
+
+        switch (residency) {
+        case MeshResidency::KeepAll:
+            // the full data serves everyone the compact copy did
+            _positions = {};
+            _indices = {};
+            return;
+        case MeshResidency::PositionsOnly:
+            _positions.resize(_data->vertices.size());
+            for (size_t i = 0; i < _data->vertices.size(); i++) {
+                _positions[i] = _data->vertices[i].pos;
+            }
+            _indices = _data->indices;
+            break;
+        default:
+            _positions = {};
+            _indices = {};
+            break;
+        }
+        _data = nullptr;
+    }
+
+    MeshLoadHandle MeshAsset::RequestCpuData() {
+        if (_load.valid()) {
+            return _load;
+        }
+
+        if (_data != nullptr) {
+            std::promise<std::shared_ptr<MeshData>> resident;
+            resident.set_value(_data);
+            return resident.get_future().share();
+        }
+
+        _restreaming = true;
+        LoadAsync();
+        return _load;
+    }
+
+    std::shared_ptr<MeshAsset> MeshAssetCache::Acquire(const std::string &path) {
+        std::string key = NormalizePath(path);
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        std::shared_ptr<MeshAsset> asset = _assets[key].lock();
+        if (asset == nullptr) {
+            // drop entries whose assets have been freed before adding a new one
+            std::erase_if(_assets, [](const auto &entry) { return entry.second.expired(); });
+
+            asset = std::make_shared<MeshAsset>(key);
+            asset->LoadAsync();
+            _assets[key] = asset;
+        }
+        return asset;
+    }
+
+    std::shared_ptr<MeshAsset> MeshAssetCache::Find(const std::string &path) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto it = _assets.find(NormalizePath(path));
+        return it != _assets.end() ? it->second.lock() : nullptr;
+    }
+
+    size_t MeshAssetCache::Count() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return std::count_if(_assets.begin(), _assets.end(), [](const auto &entry) { return !entry.second.expired(); });
+    }
+
+    std::string MeshAssetCache::NormalizePath(const std::string &path) {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+} // namespace IC
@@ -0,0 +1,289 @@
+#include "ic_occlusion.h"
+
+#include "ic_job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <xmmintrin.h>
+#define IC_OCCLUSION_SSE
+#endif
+
+namespace IC {
+    namespace {
+        glm::vec4 TransformPoint(const glm::mat4 &matrix, const glm::vec3 &point) {
+#ifdef IC_OCCLUSION_SSE
+            __m128 result = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&matrix[0][0]), _mm_set1_ps(point.x)),
+                           _mm_mul_ps(_mm_loadu_ps(&matrix[1][0]), _mm_set1_ps(point.y))),
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&matrix[2][0]), _mm_set1_ps(point.z)), _mm_loadu_ps(&matrix[3][0])));
+            glm::vec4 clip;
+            _mm_storeu_ps(&clip.x, result);
+            return clip;
+#else
+            return matrix * glm::vec4(point, 1.0f);
+#endif
+        }
+
+        // pixel coordinates of a clip space point, which has to be in front of the camera
+        glm::vec3 ToScreen(const glm::vec4 &clip) {
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            return {(ndc.x * 0.5f + 0.5f) * OcclusionBuffer::WIDTH, (ndc.y * 0.5f + 0.5f) * OcclusionBuffer::HEIGHT,
+                    ndc.z};
+        }
+
+        // Tiles taken by whichever thread gets to them first. Owned by the helper jobs too, as they may only start
+        // after every tile is done.
+        struct TileQueue {
+            std::vector<uint32_t> tiles;
+            std::atomic<uint32_t> next = 0;
+            std::atomic<uint32_t> finished = 0;
+        };
+    } // namespace
+
+    OcclusionBuffer::OcclusionBuffer() : _depth(WIDTH * HEIGHT, 1.0f), _bins(TILES_X * TILES_Y) {}
+
+    void OcclusionBuffer::Begin(const glm::mat4 &viewProjection) {
+        _viewProjection = viewProjection;
+        std::fill(_depth.begin(), _depth.end(), 1.0f);
+        _triangles.clear();
+        for (std::vector<uint32_t> &bin : _bins) {
+            bin.clear();
+        }
+    }
+
+    void OcclusionBuffer::AddOccluder(MeshAsset &asset, const glm::mat4 &model) {
+        glm::mat4 matrix = _viewProjection * model;
+        if (asset.HasCpuData()) {
+            std::vector<VertexData> &vertices = asset.Data()->vertices;
+            _clipVertices.resize(vertices.size());
+            for (size_t i = 0; i < vertices.size(); i++) {
+                _clipVertices[i] = TransformPoint(matrix, vertices[i].pos);
+            }
+        } else {
+            std::vector<glm::vec3> &positions = asset.Positions();
+            _clipVertices.resize(positions.size());
+            for (size_t i = 0; i < positions.size(); i++) {
+                _clipVertices[i] = TransformPoint(matrix, positions[i]);
+            }
+        }
+        if (_clipVertices.empty()) {
+            return;
+        }
+
+        std::vector<uint32_t> &indices = asset.Indices();
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            AddTriangle(_clipVertices[indices[i]], _clipVertices[indices[i + 1]], _clipVertices[indices[i + 2]]);
+        }
+    }
+
+    void OcclusionBuffer::AddTriangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2) {
+        // The part in front of the near plane isn't drawn, so what is behind it may show. Dropping the triangle
+        // instead of clipping it only hides less.
+        if (v0.z < 0.0f || v1.z < 0.0f || v2.z < 0.0f) {
+            return;
+        }
+
+        glm::vec3 p0 = ToScreen(v0);
+        glm::vec3 p1 = ToScreen(v1);
+        glm::vec3 p2 = ToScreen(v2);
+        float area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+        if (std::abs(area) < 1e-6f) {
+            return;
+        }
+        // both faces occlude, wind them the same way
+        if (area < 0.0f) {
+            std::swap(p1, p2);
+            area = -area;
+        }
+
+        Triangle triangle{};
+        triangle.minX = std::max(static_cast<int>(std::ceil(std::min({p0.x, p1.x, p2.x}) - 0.5f)), 0);
+        triangle.minY = std::max(static_cast<int>(std::ceil(std::min({p0.y, p1.y, p2.y}) - 0.5f)), 0);
+        triangle.maxX =
+            std::min(static_cast<int>(std::floor(std::max({p0.x, p1.x, p2.x}) - 0.5f)), static_cast<int>(WIDTH) - 1);
+        triangle.maxY =
+            std::min(static_cast<int>(std::floor(std::max({p0.y, p1.y, p2.y}) - 0.5f)), static_cast<int>(HEIGHT) - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            return;
+        }
+
+        const glm::vec3 *corners[] = {&p0, &p1, &p2};
+        for (int edge = 0; edge < 3; edge++) {
+            const glm::vec3 &from = *corners[edge];
+            const glm::vec3 &to = *corners[(edge + 1) % 3];
+            triangle.edgeA[edge] = from.y - to.y;
+            triangle.edgeB[edge] = to.x - from.x;
+            triangle.edgeC[edge] = -(triangle.edgeA[edge] * from.x + triangle.edgeB[edge] * from.y);
+        }
+
+        triangle.depthX = ((p1.z - p0.z) * (p2.y - p0.y) - (p2.z - p0.z) * (p1.y - p0.y)) / area;
+        triangle.depthY = ((p2.z - p0.z) * (p1.x - p0.x) - (p1.z - p0.z) * (p2.x - p0.x)) / area;
+        // depth at a pixel center plus the most it changes towards the pixel's corners
+        triangle.depth0 = p0.z - triangle.depthX * p0.x - triangle.depthY * p0.y +
+                          0.5f * (std::abs(triangle.depthX) + std::abs(triangle.depthY));
+
+        uint32_t index = static_cast<uint32_t>(_triangles.size());
+        _triangles.push_back(triangle);
+        for (uint32_t tileY = triangle.minY / TILE_HEIGHT; tileY <= triangle.maxY / TILE_HEIGHT; tileY++) {
+            for (uint32_t tileX = triangle.minX / TILE_WIDTH; tileX <= triangle.maxX / TILE_WIDTH; tileX++) {
+                _bins[tileY * TILES_X + tileX].push_back(index);
+            }
+        }
+    }
+
+    // The calling thread works through the tiles too, so it never waits for helpers still queued behind unrelated
+    // jobs, only for tiles already being rasterized
+    void OcclusionBuffer::Rasterize() {
+        auto queue = std::make_shared<TileQueue>();
+        for (uint32_t tile = 0; tile < _bins.size(); tile++) {
+            if (!_bins[tile].empty()) {
+                queue->tiles.push_back(tile);
+            }
+        }
+        uint32_t count = static_cast<uint32_t>(queue->tiles.size());
+        if (count == 0) {
+            return;
+        }
+
+        // late helpers find no tiles left and return without touching the buffer
+        auto work = [this, queue, count]() {
+            for (uint32_t i = queue->next++; i < count; i = queue->next++) {
+                RasterizeTile(queue->tiles[i]);
+                if (++queue->finished == count) {
+                    queue->finished.notify_all();
+                }
+            }
+        };
+        size_t helpers = std::min<size_t>(JobSystem::WorkerCount(), count - 1);
+        for (size_t i = 0; i < helpers; i++) {
+            JobSystem::Schedule(work);
+        }
+        work();
+
+        for (uint32_t finished = queue->finished; finished < count; finished = queue->finished) {
+            queue->finished.wait(finished);
+        }
+    }
+
+    // Each tile only writes its own pixels, so tiles need no synchronization
+    void OcclusionBuffer::RasterizeTile(uint32_t tile) {
+        int tileX = static_cast<int>((tile % TILES_X) * TILE_WIDTH);
+        int tileY = static_cast<int>((tile / TILES_X) * TILE_HEIGHT);
+        float *tileDepth = &_depth[tile * TILE_PIXELS];
+
+        for (uint32_t index : _bins[tile]) {
+            const Triangle &triangle = _triangles[index];
+            // rows are walked in steps of four from a multiple of four, which stays within the tile
+            int minX = tileX + ((std::max(triangle.minX, tileX) - tileX) & ~3);
+            int maxX = std::min(triangle.maxX, tileX + static_cast<int>(TILE_WIDTH) - 1);
+            int minY = std::max(triangle.minY, tileY);
+            int maxY = std::min(triangle.maxY, tileY + static_cast<int>(TILE_HEIGHT) - 1);
+
+            for (int y = minY; y <= maxY; y++) {
+                float centerY = y + 0.5f;
+                float *row = tileDepth + (y - tileY) * TILE_WIDTH - tileX;
+#ifdef IC_OCCLUSION_SSE
+                __m128 edgeRow[3];
+                for (int edge = 0; edge < 3; edge++) {
+                    edgeRow[edge] = _mm_set1_ps(triangle.edgeB[edge] * centerY + triangle.edgeC[edge]);
+                }
+                __m128 depthRow = _mm_set1_ps(triangle.depthY * centerY + triangle.depth0);
+                for (int x = minX; x <= maxX; x += 4) {
+                    __m128 centerX = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+                    __m128 inside = _mm_cmpge_ps(
+                        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[0]), centerX), edgeRow[0]), _mm_setzero_ps());
+                    for (int edge = 1; edge < 3; edge++) {
+                        __m128 distance =
+                            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[edge]), centerX), edgeRow[edge]);
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+                    }
+                    if (_mm_movemask_ps(inside) == 0) {
+                        continue;
+                    }
+
+                    __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthX), centerX), depthRow);
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(current, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+                }
+#else
+                for (int x = minX; x <= maxX; x++) {
+                    float centerX = x + 0.5f;
+                    bool inside = true;
+                    for (int edge = 0; edge < 3; edge++) {
+                        float distance =
+                            triangle.edgeA[edge] * centerX + triangle.edgeB[edge] * centerY + triangle.edgeC[edge];
+                        inside = inside && distance >= 0.0f;
+                    }
+                    if (inside) {
+                        float depth = triangle.depthX * centerX + triangle.depthY * centerY + triangle.depth0;
+                        row[x] = std::min(row[x], depth);
+                    }
+                }
+#endif
+            }
+        }
+    }
+
+    bool OcclusionBuffer::IsOccluded(const BoundingBox &bounds) const {
+        glm::vec2 screenMin{WIDTH, HEIGHT};
+        glm::vec2 screenMax{0.0f};
+        float nearestDepth = 1.0f;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 point{corner & 1 ? bounds.max.x : bounds.min.x, corner & 2 ? bounds.max.y : bounds.min.y,
+                            corner & 4 ? bounds.max.z : bounds.min.z};
+            glm::vec4 clip = TransformPoint(_viewProjection, point);
+            // boxes reaching past the near plane cover the camera
+            if (clip.z < 0.0f) {
+                return false;
+            }
+
+            glm::vec3 screen = ToScreen(clip);
+            screenMin = glm::min(screenMin, glm::vec2(screen));
+            screenMax = glm::max(screenMax, glm::vec2(screen));
+            nearestDepth = std::min(nearestDepth, screen.z);
+        }
+
+        // one pixel wider on each side, clamped before converting to stay in range
+        int minX = static_cast<int>(std::floor(std::max(screenMin.x, -1.0f))) - 1;
+        int minY = static_cast<int>(std::floor(std::max(screenMin.y, -1.0f))) - 1;
+        int maxX = static_cast<int>(std::floor(std::min(screenMax.x, static_cast<float>(WIDTH)))) + 1;
+        int maxY = static_cast<int>(std::floor(std::min(screenMax.y, static_cast<float>(HEIGHT)))) + 1;
+        minX = std::max(minX, 0);
+        minY = std::max(minY, 0);
+        maxX = std::min(maxX, static_cast<int>(WIDTH) - 1);
+        maxY = std::min(maxY, static_cast<int>(HEIGHT) - 1);
+        if (minX > maxX || minY > maxY) {
+            return false;
+        }
+
+        // any pixel as far as the box or farther may let it through
+        for (int y = minY; y <= maxY; y++) {
+#ifdef IC_OCCLUSION_SSE
+            __m128 boxDepth = _mm_set1_ps(nearestDepth);
+            for (int x = minX & ~3; x <= maxX; x += 4) {
+                __m128 depth = _mm_loadu_ps(&_depth[PixelIndex(x, y)]);
+                if (_mm_movemask_ps(_mm_cmpge_ps(depth, boxDepth)) != 0) {
+                    return false;
+                }
+            }
+#else
+            for (int x = minX; x <= maxX; x++) {
+                if (_depth[PixelIndex(x, y)] >= nearestDepth) {
+                    return false;
+                }
+            }
+#endif
+        }
+        return true;
+    }
+
+    uint32_t OcclusionBuffer::PixelIndex(uint32_t x, uint32_t y) {
+        uint32_t tile = (y / TILE_HEIGHT) * TILES_X + x / TILE_WIDTH;
+        return tile * TILE_PIXELS + (y % TILE_HEIGHT) * TILE_WIDTH + x % TILE_WIDTH;
+    }
+} // namespace IC
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <ic_graphics.h>
+#include <ic_mesh_asset.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace IC {
+    // Small depth buffer that occluder meshes are rasterized into on the cpu, so objects hidden behind them can be
+    // skipped before any commands are recorded. The buffer is split into tiles that are rasterized by their own jobs,
+    // four pixels at a time with SSE. Depth goes from 0 at the near plane to 1 at the far plane.
+    //
+    // Pixels are covered where their centers are, and hold the farthest depth of the occluder within them. Tests widen
+    // an object's screen rect by a pixel, so objects peeking out past an occluder's edge stay visible.
+    class OcclusionBuffer {
+    public:
+        static constexpr uint32_t WIDTH = 256;
+        static constexpr uint32_t HEIGHT = 128;
+        static constexpr uint32_t TILE_WIDTH = 64;
+        static constexpr uint32_t TILE_HEIGHT = 32;
+
+        OcclusionBuffer();
+
+        // Clears the buffer and drops the occluders of the last frame
+        void Begin(const glm::mat4 &viewProjection);
+        // Sets up the triangles of an occluder. Skipped if the asset keeps no vertex positions on the cpu.
+        void AddOccluder(MeshAsset &asset, const glm::mat4 &model);
+        // Rasterizes the occluders on the calling thread and the job system. Returns once every tile is done.
+        void Rasterize();
+
+        // True if the box is behind the occluders everywhere it covers on screen
+        bool IsOccluded(const BoundingBox &bounds) const;
+
+    private:
+        static constexpr uint32_t TILES_X = WIDTH / TILE_WIDTH;
+        static constexpr uint32_t TILES_Y = HEIGHT / TILE_HEIGHT;
+        static constexpr uint32_t TILE_PIXELS = TILE_WIDTH * TILE_HEIGHT;
+
+        // screen space triangle, set up for rasterizing
+        struct Triangle {
+            // edge functions a * x + b * y + c, positive inside
+            glm::vec3 edgeA, edgeB, edgeC;
+            // depth plane depthX * x + depthY * y + depth0, raised to the farthest depth within a pixel
+            float depthX, depthY, depth0;
+            // covered pixels, inclusive
+            int minX, minY, maxX, maxY;
+        };
+
+        void AddTriangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2);
+        void RasterizeTile(uint32_t tile);
+        static uint32_t PixelIndex(uint32_t x, uint32_t y);
+
+        glm::mat4 _viewProjection{1.0f};
+        // tile by tile, rows within a tile
+        std::vector<float> _depth;
+        std::vector<Triangle> _triangles;
+        // triangles overlapping each tile
+        std::vector<std::vector<uint32_t>> _bins;
+        // scratch for the occluder being added, kept to avoid allocating every frame
+        std::vector<glm::vec4> _clipVertices;
+    };
+} // namespace IC
@@ -3,6 +3,7 @@
 #include "vulkan/vulkan_renderer.h"
 
 #include <algorithm>
+#include <optional>
 
 namespace IC {
     Renderer::Renderer(const RendererConfig &config) : window(config.window) {
@@ -11,6 +12,13 @@ namespace IC {
 
     Renderer::~Renderer() {
         RemoveImguiFunction(STATS_WINDOW_NAME);
+        // the objects may outlive the renderer
+        for (SceneObject &sceneObject : sceneObjects) {
+            sceneObject.object->GetTransform()->SetChangedCallback(nullptr);
+            if (auto mesh = sceneObject.object->GetComponent<Mesh>()) {
+                mesh->SetChangedCallback(nullptr);
+            }
+        }
     }
 
     Renderer *Renderer::MakeRenderer(const RendererConfig &rendererConfig) {
@@ -30,10 +38,90 @@ namespace IC {
         ImGui::Begin("Render Stats");
         ImGui::Text("frametime %f ms (%f FPS)", renderStats.frametime, 1 / (renderStats.frametime / 1000));
         ImGui::Text("rendered tris: %d", renderStats.numTris);
-        ImGui::Text("draw calls: %d", renderStats.drawCalls);
+        ImGui::Text("draw calls: %d, instances: %d", renderStats.drawCalls, renderStats.instances);
+        ImGui::Text("culled objects: %d, culled tris: %d", renderStats.culledObjects, renderStats.culledTris);
+        ImGui::Text("occluded objects: %d, occluded tris: %d", renderStats.occludedObjects, renderStats.occludedTris);
+        ImGui::Text("pipeline binds: %d, geometry binds: %d", renderStats.pipelineBinds, renderStats.geometryBinds);
+        ImGui::Text("texture memory: %.1f MB", renderStats.textureMemory / (1024.0 * 1024.0));
         ImGui::End();
     }
 
+    std::vector<std::shared_ptr<GameObject>> Renderer::QueryRay(const Ray &ray, float maxDistance) {
+        std::vector<uint32_t> indices;
+        sceneBvh.QueryRay(ray, maxDistance, indices);
+        return SceneObjects(indices);
+    }
+
+    std::vector<std::shared_ptr<GameObject>> Renderer::QueryBox(const BoundingBox &bounds) {
+        std::vector<uint32_t> indices;
+        sceneBvh.QueryBox(bounds, indices);
+        return SceneObjects(indices);
+    }
+
+    std::vector<std::shared_ptr<GameObject>> Renderer::QuerySphere(const BoundingSphere &sphere) {
+        std::vector<uint32_t> indices;
+        sceneBvh.QuerySphere(sphere, indices);
+        return SceneObjects(indices);
+    }
+
+    void Renderer::AddSceneObject(std::shared_ptr<GameObject> object, uint32_t renderIndex) {
+        if (!object->HasComponent<Mesh>() && !object->HasComponent<PointLight>()) {
+            return;
+        }
+        uint32_t index = static_cast<uint32_t>(sceneObjects.size());
+        uint32_t proxy = sceneBvh.Insert(SceneObjectBounds(*object), index);
+        sceneObjects.push_back({object, proxy, renderIndex});
+
+        auto changed = [this, index]() { changedSceneObjects.push_back(index); };
+        object->GetTransform()->SetChangedCallback(changed);
+        object->GetTransform()->ClearChanged();
+        if (auto mesh = object->GetComponent<Mesh>()) {
+            mesh->SetChangedCallback(changed);
+            mesh->ClearChanged();
+        }
+    }
+
+    void Renderer::UpdateSceneBounds() {
+        for (uint32_t index : changedSceneObjects) {
+            GameObject &object = *sceneObjects[index].object;
+            sceneBvh.Move(sceneObjects[index].proxy, SceneObjectBounds(object));
+            object.GetTransform()->ClearChanged();
+            if (auto mesh = object.GetComponent<Mesh>()) {
+                mesh->ClearChanged();
+            }
+        }
+        changedSceneObjects.clear();
+        sceneBvh.Commit();
+    }
+
+    BoundingBox Renderer::SceneObjectBounds(GameObject &object) {
+        Transform &transform = *object.GetTransform();
+        std::optional<BoundingBox> bounds;
+        if (auto mesh = object.GetComponent<Mesh>()) {
+            bounds = TransformBounds(mesh->LocalBounds(), transform.ModelMatrix());
+        }
+        // lights too dim to reach anything have no bounds of their own
+        auto light = object.GetComponent<PointLight>();
+        if (light != nullptr && light->Range() > 0.0f) {
+            BoundingBox lightBounds{transform.Position() - light->Range(), transform.Position() + light->Range()};
+            if (bounds) {
+                lightBounds.min = glm::min(lightBounds.min, bounds->min);
+                lightBounds.max = glm::max(lightBounds.max, bounds->max);
+            }
+            bounds = lightBounds;
+        }
+        return bounds.value_or(BoundingBox{transform.Position(), transform.Position()});
+    }
+
+    std::vector<std::shared_ptr<GameObject>> Renderer::SceneObjects(const std::vector<uint32_t> &indices) {
+        std::vector<std::shared_ptr<GameObject>> objects;
+        objects.reserve(indices.size());
+        for (uint32_t index : indices) {
+            objects.push_back(sceneObjects[index].object);
+        }
+        return objects;
+    }
+
     void Renderer::AddImguiFunction(std::string windowName, std::function<void()> function) {
         imGuiFunctions[windowName] = function;
     }
@@ -3,6 +3,8 @@
 #include <ic_gameobject.h>
 #include <ic_graphics.h>
 
+#include "ic_bvh.h"
+
 #include <GLFW/glfw3.h>
 
 #include <algorithm>
@@ -19,12 +21,28 @@ namespace IC {
         GLFWwindow *window;
         int width;
         int height;
+        // Lays down depth for lit opaque objects before shading them, so overlapping geometry isn't lit more than
+        // once per pixel. Costs an extra geometry pass.
+        bool depthPrepass = true;
+        // Skips objects hidden behind others. Devices culling on the gpu test against the depth of what was drawn
+        // so far, otherwise objects are tested against the meshes marked as occluders.
+        bool occlusionCulling = true;
     };
 
     struct RenderStats {
         float frametime;
         uint32_t numTris;
         uint32_t drawCalls;
+        // objects submitted with those draws
+        uint32_t instances;
+        uint32_t pipelineBinds;
+        uint32_t geometryBinds;
+        uint32_t culledObjects;
+        uint32_t culledTris;
+        // objects in the frustum found to be hidden, not included in the counts above
+        uint32_t occludedObjects;
+        uint32_t occludedTris;
+        uint64_t textureMemory;
     };
 
     class Renderer {
@@ -40,7 +58,37 @@ namespace IC {
         void AddImguiFunction(std::string windowName, std::function<void()> function);
         void RemoveImguiFunction(std::string windowName);
 
+        // Scene queries over every object with a mesh or point light, tested against their bounds as of the last
+        // drawn frame.
+        std::vector<std::shared_ptr<GameObject>> QueryRay(const Ray &ray, float maxDistance);
+        std::vector<std::shared_ptr<GameObject>> QueryBox(const BoundingBox &bounds);
+        std::vector<std::shared_ptr<GameObject>> QuerySphere(const BoundingSphere &sphere);
+
     protected:
+        static constexpr uint32_t NO_RENDER_INDEX = UINT32_MAX;
+
+        struct SceneObject {
+            std::shared_ptr<GameObject> object;
+            uint32_t proxy;
+            // renderer specific index of the object's draw data, NO_RENDER_INDEX for lights
+            uint32_t renderIndex;
+        };
+
+        // Registers an object with the scene hierarchy if it has a mesh or point light. Directional lights are
+        // unbounded and left out.
+        void AddSceneObject(std::shared_ptr<GameObject> object, uint32_t renderIndex);
+        // Refits the hierarchy to the transforms and mesh bounds that changed since the last call. Called once per
+        // frame before culling.
+        void UpdateSceneBounds();
+        BoundingBox SceneObjectBounds(GameObject &object);
+        std::vector<std::shared_ptr<GameObject>> SceneObjects(const std::vector<uint32_t> &indices);
+
+        // user data of the proxies indexes sceneObjects
+        BoundingVolumeHierarchy sceneBvh;
+        std::vector<SceneObject> sceneObjects;
+        // indices into sceneObjects whose transform or mesh changed since the last UpdateSceneBounds
+        std::vector<uint32_t> changedSceneObjects;
+
         std::unordered_map<std::string, std::function<void()>> imGuiFunctions;
         GLFWwindow *window;
         RenderStats renderStats{};
@@ -0,0 +1,174 @@
+#include "depth_pyramid.h"
+
+#include "pipelines.h"
+#include "shader_compiler.h"
+#include "vulkan_initializers.h"
+#include "vulkan_util.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace IC {
+    namespace {
+        const std::string REDUCE_SHADER_PATH = "resources/shaders/depth_pyramid.comp";
+        // matches local_size_x and local_size_y in the reduction shader
+        constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+    } // namespace
+
+    DepthPyramid::DepthPyramid(VulkanDevice &device, VulkanAllocator &allocator)
+        : _device{device}, _allocator{allocator} {
+        VkSamplerCreateInfo samplerInfo{.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        VK_CHECK(vkCreateSampler(_device.Device(), &samplerInfo, nullptr, &_sampler));
+
+        CreateReducePipeline();
+    }
+
+    DepthPyramid::~DepthPyramid() {
+        DestroyPyramid();
+        vkDestroySampler(_device.Device(), _sampler, nullptr);
+        vkDestroyPipeline(_device.Device(), _reducePipeline, nullptr);
+        vkDestroyPipelineLayout(_device.Device(), _reducePipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(_device.Device(), _reduceSetLayout, nullptr);
+    }
+
+    void DepthPyramid::Resize(SwapChain &swapChain) {
+        VkDevice device = _device.Device();
+        DestroyPyramid();
+
+        // power of two levels halve exactly, only the top level reduces an uneven footprint
+        VkExtent2D depthExtent = swapChain.GetSwapChainExtent();
+        _extent = {std::bit_floor(depthExtent.width), std::bit_floor(depthExtent.height)};
+        _levelCount = std::bit_width(std::max(_extent.width, _extent.height));
+        _allocator.CreateImage({_extent.width, _extent.height, 1}, VK_FORMAT_R32_SFLOAT,
+                               VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, _pyramid, _levelCount);
+
+        _levelViews.resize(_levelCount);
+        for (uint32_t level = 0; level < _levelCount; level++) {
+            VkImageViewCreateInfo viewInfo =
+                ImageViewCreateInfo(VK_FORMAT_R32_SFLOAT, _pyramid.image, VK_IMAGE_ASPECT_COLOR_BIT);
+            viewInfo.subresourceRange.baseMipLevel = level;
+            VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &_levelViews[level]));
+        }
+
+        uint32_t imageCount = static_cast<uint32_t>(swapChain.ImageCount());
+        uint32_t setCount = _levelCount - 1 + imageCount;
+        _descriptorAllocator.CreateDescriptorPool(device,
+                                                  {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount},
+                                                   {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount}},
+                                                  setCount);
+
+        std::vector<VkDescriptorSetLayout> layouts(setCount, _reduceSetLayout);
+        std::vector<VkDescriptorSet> sets(setCount);
+        VkDescriptorSetAllocateInfo allocInfo{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        allocInfo.descriptorPool = _descriptorAllocator.GetDescriptorPool();
+        allocInfo.descriptorSetCount = setCount;
+        allocInfo.pSetLayouts = layouts.data();
+        VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, sets.data()));
+        _depthSets.assign(sets.begin(), sets.begin() + imageCount);
+        _levelSets.assign(sets.begin() + imageCount, sets.end());
+
+        DescriptorWriter writer{};
+        for (uint32_t i = 0; i < imageCount; i++) {
+            writer.WriteImage(0, swapChain.GetDepthImage(i).view, _sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+            writer.WriteImage(1, _levelViews[0], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL,
+                              VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.UpdateSet(device, _depthSets[i]);
+            writer.Clear();
+        }
+        for (uint32_t level = 1; level < _levelCount; level++) {
+            writer.WriteImage(0, _levelViews[level - 1], _sampler, VK_IMAGE_LAYOUT_GENERAL,
+                              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+            writer.WriteImage(1, _levelViews[level], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL,
+                              VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+            writer.UpdateSet(device, _levelSets[level - 1]);
+            writer.Clear();
+        }
+    }
+
+    void DepthPyramid::Build(VkCommandBuffer cBuffer, SwapChain &swapChain, uint32_t imageIndex) {
+        VkImage depthImage = swapChain.GetDepthImage(imageIndex).image;
+        VkImageAspectFlags depthAspect = DepthAspectFlags(swapChain.GetSwapChainDepthFormat());
+
+        // the whole pyramid is rewritten, so its previous contents can be dropped
+        VkImageMemoryBarrier readBarriers[] = {
+            ImageMemoryBarrier(depthImage, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                               VK_ACCESS_SHADER_READ_BIT),
+            ImageMemoryBarrier(_pyramid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, 0,
+                               VK_ACCESS_SHADER_WRITE_BIT, _levelCount)};
+        readBarriers[0].subresourceRange.aspectMask = depthAspect;
+        vkCmdPipelineBarrier(cBuffer,
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, readBarriers);
+
+        vkCmdBindPipeline(cBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _reducePipeline);
+        for (uint32_t level = 0; level < _levelCount; level++) {
+            VkDescriptorSet set = level == 0 ? _depthSets[imageIndex] : _levelSets[level - 1];
+            vkCmdBindDescriptorSets(cBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _reducePipelineLayout, 0, 1, &set, 0,
+                                    nullptr);
+            uint32_t width = std::max(_extent.width >> level, 1u);
+            uint32_t height = std::max(_extent.height >> level, 1u);
+            vkCmdDispatch(cBuffer, (width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+                          (height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+            // the next level and the culling pass read this one
+            VkMemoryBarrier levelBarrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+            levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(cBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                 1, &levelBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        VkImageMemoryBarrier depthBarrier = ImageMemoryBarrier(
+            depthImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, 0,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+        depthBarrier.subresourceRange.aspectMask = depthAspect;
+        vkCmdPipelineBarrier(cBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &depthBarrier);
+    }
+
+    void DepthPyramid::CreateReducePipeline() {
+        VkDevice device = _device.Device();
+
+        DescriptorLayoutBuilder layoutBuilder{};
+        layoutBuilder.AddBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER); // source depth
+        layoutBuilder.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);          // reduced level
+        _reduceSetLayout = layoutBuilder.Build(device, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &_reduceSetLayout;
+        VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &_reducePipelineLayout));
+
+        VkShaderModule shader = PipelineBuilder::CreateShaderModule(device, LoadShaderCode(REDUCE_SHADER_PATH));
+        PipelineBuilder pipelineBuilder{};
+        pipelineBuilder.SetComputeShader(shader);
+        pipelineBuilder.pipelineLayout = _reducePipelineLayout;
+        _reducePipeline = pipelineBuilder.BuildComputePipeline(device);
+        vkDestroyShaderModule(device, shader, nullptr);
+    }
+
+    void DepthPyramid::DestroyPyramid() {
+        if (_levelCount == 0) {
+            return;
+        }
+
+        for (VkImageView view : _levelViews) {
+            vkDestroyImageView(_device.Device(), view, nullptr);
+        }
+        _levelViews.clear();
+        _descriptorAllocator.DestroyDescriptorPool(_device.Device());
+        _allocator.DestroyImage(_pyramid);
+        _levelCount = 0;
+    }
+} // namespace IC
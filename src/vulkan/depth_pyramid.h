@@ -0,0 +1,56 @@
+#pragma once
+
+#include "descriptors.h"
+#include "swap_chain.h"
+#include "vulkan_allocator.h"
+#include "vulkan_device.h"
+#include "vulkan_types.h"
+
+#include <vector>
+
+namespace IC {
+    // Mip chain of the scene depth, where every texel holds the farthest depth of the texels it covers. Occlusion
+    // culling compares an object's nearest depth against the texels around its screen rect at the level where the
+    // rect spans at most two texels. The top level is the depth image's size rounded down to a power of two.
+    class DepthPyramid {
+    public:
+        DepthPyramid(VulkanDevice &device, VulkanAllocator &allocator);
+        ~DepthPyramid();
+
+        // Sizes the pyramid for the swap chain's depth images. Has to be called whenever the swap chain is recreated.
+        void Resize(SwapChain &swapChain);
+        // Reduces the depth image into the pyramid. Has to be recorded outside of rendering, the depth image is
+        // ready to be rendered to again afterwards.
+        void Build(VkCommandBuffer cBuffer, SwapChain &swapChain, uint32_t imageIndex);
+
+        // whole mip chain, in general layout
+        VkImageView View() { return _pyramid.view; }
+        VkSampler Sampler() { return _sampler; }
+
+    private:
+        DepthPyramid(const DepthPyramid &) = delete;
+        DepthPyramid &operator=(const DepthPyramid &) = delete;
+
+        void CreateReducePipeline();
+        void DestroyPyramid();
+
+        VulkanDevice &_device;
+        VulkanAllocator &_allocator;
+
+        AllocatedImage _pyramid{};
+        VkExtent2D _extent{};
+        uint32_t _levelCount = 0;
+        // one view per level, written by the reduction
+        std::vector<VkImageView> _levelViews;
+        VkSampler _sampler = VK_NULL_HANDLE;
+
+        // level set i reduces level i into level i + 1. Level 0 is reduced from a depth image, with a set per swap
+        // chain image.
+        std::vector<VkDescriptorSet> _levelSets;
+        std::vector<VkDescriptorSet> _depthSets;
+        DescriptorAllocator _descriptorAllocator{};
+        VkDescriptorSetLayout _reduceSetLayout = VK_NULL_HANDLE;
+        VkPipelineLayout _reducePipelineLayout = VK_NULL_HANDLE;
+        VkPipeline _reducePipeline = VK_NULL_HANDLE;
+    };
+} // namespace IC
@@ -3,11 +3,13 @@
 #include "swap_chain.h"
 
 namespace IC {
-    void DescriptorLayoutBuilder::AddBinding(uint32_t binding, VkDescriptorType type) {
+    void DescriptorLayoutBuilder::AddBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stages,
+                                             uint32_t count) {
         VkDescriptorSetLayoutBinding newBinding{};
         newBinding.binding = binding;
-        newBinding.descriptorCount = 1;
+        newBinding.descriptorCount = count;
         newBinding.descriptorType = type;
+        newBinding.stageFlags = stages;
 
         bindings.push_back(newBinding);
     }
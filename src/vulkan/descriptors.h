@@ -10,7 +10,8 @@ namespace IC {
     struct DescriptorLayoutBuilder {
         std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-        void AddBinding(uint32_t binding, VkDescriptorType type);
+        // stages are added to the ones passed to Build
+        void AddBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stages = 0, uint32_t count = 1);
         void Clear();
         VkDescriptorSetLayout Build(VkDevice device, VkShaderStageFlags shaderStages);
     };
@@ -0,0 +1,199 @@
+#include "gpu_scene.h"
+
+#include <ic_log.h>
+
+#include "pipelines.h"
+#include "shader_compiler.h"
+#include "swap_chain.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace IC {
+    namespace {
+        const std::string CULLING_SHADER_PATH = "resources/shaders/cull_objects.comp";
+        // matches local_size_x in the culling shader
+        constexpr uint32_t CULLING_GROUP_SIZE = 64;
+    } // namespace
+
+    GpuScene::GpuScene(VulkanDevice &device, VulkanAllocator &allocator)
+        : _device{device}, _allocator{allocator}, _frames(SwapChain::MAX_FRAMES_IN_FLIGHT) {
+        _gpuDriven = _device.drawIndirectCount;
+        if (_gpuDriven) {
+            CreateCullingPipeline();
+        } else {
+            IC_CORE_INFO("Indirect count draws are not supported, objects are culled on the cpu.");
+        }
+
+        for (size_t i = 0; i < _frames.size(); i++) {
+            if (_gpuDriven) {
+                _allocator.CreateBuffer(sizeof(CullingData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO,
+                                        _frames[i].culling);
+                // read back on the cpu
+                _allocator.CreateBuffer(sizeof(CullingStats),
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                        VMA_MEMORY_USAGE_AUTO, _frames[i].stats,
+                                        VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+            }
+            Reserve(i, GrowableBuffer::MIN_CAPACITY, GrowableBuffer::MIN_CAPACITY, GrowableBuffer::MIN_CAPACITY);
+        }
+    }
+
+    GpuScene::~GpuScene() {
+        for (FrameBuffers &frame : _frames) {
+            frame.objects.Destroy(_allocator);
+            frame.commands.Destroy(_allocator);
+            frame.counts.Destroy(_allocator);
+            if (_gpuDriven) {
+                _allocator.DestroyBuffer(frame.culling);
+                _allocator.DestroyBuffer(frame.stats);
+            }
+        }
+        _visibility.Destroy(_allocator);
+        if (_gpuDriven) {
+            _descriptorAllocator.DestroyDescriptorPool(_device.Device());
+            vkDestroyPipeline(_device.Device(), _cullingPipeline, nullptr);
+            vkDestroyPipelineLayout(_device.Device(), _cullingPipelineLayout, nullptr);
+            vkDestroyDescriptorSetLayout(_device.Device(), _cullingSetLayout, nullptr);
+        }
+    }
+
+    bool GpuScene::Reserve(size_t frame, uint32_t objectCount, uint32_t batchCount, uint32_t renderObjectCount) {
+        FrameBuffers &buffers = _frames[frame];
+        bool objectsReplaced = buffers.objects.Reserve(_allocator, objectCount);
+        bool batchesReplaced = false;
+        bool visibilityReplaced = false;
+        if (_gpuDriven) {
+            buffers.commands.Reserve(_allocator, objectCount);
+            batchesReplaced = buffers.counts.Reserve(_allocator, batchCount);
+            visibilityReplaced = _visibility.Reserve(_allocator, renderObjectCount);
+        }
+
+        if (visibilityReplaced) {
+            // the history is lost, objects are drawn by the late pass until it is built up again
+            memset(_visibility.buffer.allocInfo.pMappedData, 0, _visibility.Size());
+            for (FrameBuffers &frameBuffers : _frames) {
+                if (frameBuffers.objects.capacity > 0) {
+                    WriteCullingSet(frameBuffers);
+                }
+            }
+        } else if (_gpuDriven && (objectsReplaced || batchesReplaced)) {
+            WriteCullingSet(buffers);
+        }
+        return objectsReplaced;
+    }
+
+    void GpuScene::SetDepthPyramid(VkImageView view, VkSampler sampler) {
+        _depthPyramidView = view;
+        _depthPyramidSampler = sampler;
+        for (FrameBuffers &frame : _frames) {
+            WriteCullingSet(frame);
+        }
+    }
+
+    void GpuScene::SetCullingData(size_t frame, const CullingData &data) {
+        memcpy(_frames[frame].culling.allocInfo.pMappedData, &data, sizeof(CullingData));
+    }
+
+    void GpuScene::RecordCulling(VkCommandBuffer cBuffer, size_t frame, CullingPass pass, uint32_t batchCount) {
+        FrameBuffers &buffers = _frames[frame];
+        const CullingData &data = *static_cast<CullingData *>(buffers.culling.allocInfo.pMappedData);
+        if (pass == CullingPass::Late) {
+            // the early pass's draws have to be done with the commands and counts before they are rewritten
+            vkCmdPipelineBarrier(cBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                                 0, nullptr, 0, nullptr);
+        } else {
+            vkCmdFillBuffer(cBuffer, buffers.stats.buffer, 0, sizeof(CullingStats), 0);
+        }
+        vkCmdFillBuffer(cBuffer, buffers.counts.buffer.buffer, 0, std::max(batchCount, 1u) * sizeof(uint32_t), 0);
+
+        VkMemoryBarrier clearBarrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                             &clearBarrier, 0, nullptr, 0, nullptr);
+
+        if (data.objectCount > 0) {
+            vkCmdBindPipeline(cBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cullingPipeline);
+            vkCmdBindDescriptorSets(cBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cullingPipelineLayout, 0, 1,
+                                    &buffers.cullingSet, 0, nullptr);
+            vkCmdPushConstants(cBuffer, _cullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingPass),
+                               &pass);
+            vkCmdDispatch(cBuffer, (data.objectCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+        }
+
+        // the stats are read on the cpu after the frame
+        VkMemoryBarrier cullingBarrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        cullingBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        cullingBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cullingBarrier, 0,
+                             nullptr, 0, nullptr);
+    }
+
+    void GpuScene::DrawIndirect(VkCommandBuffer cBuffer, size_t frame, uint32_t batch, uint32_t firstCommand,
+                                uint32_t maxDrawCount) {
+        FrameBuffers &buffers = _frames[frame];
+        vkCmdDrawIndexedIndirectCount(cBuffer, buffers.commands.buffer.buffer,
+                                      firstCommand * sizeof(VkDrawIndexedIndirectCommand), buffers.counts.buffer.buffer,
+                                      batch * sizeof(uint32_t), maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    void GpuScene::CreateCullingPipeline() {
+        VkDevice device = _device.Device();
+
+        DescriptorLayoutBuilder layoutBuilder{};
+        layoutBuilder.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);         // objects
+        layoutBuilder.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);         // draw commands
+        layoutBuilder.AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);         // draw counts
+        layoutBuilder.AddBinding(3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);         // culling data
+        layoutBuilder.AddBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);         // visibility
+        layoutBuilder.AddBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);         // stats
+        layoutBuilder.AddBinding(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER); // depth pyramid
+        _cullingSetLayout = layoutBuilder.Build(device, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        VkPushConstantRange pushConstants{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingPass)};
+        VkPipelineLayoutCreateInfo layoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &_cullingSetLayout;
+        layoutInfo.pushConstantRangeCount = 1;
+        layoutInfo.pPushConstantRanges = &pushConstants;
+        VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &_cullingPipelineLayout));
+
+        VkShaderModule shader = PipelineBuilder::CreateShaderModule(device, LoadShaderCode(CULLING_SHADER_PATH));
+        PipelineBuilder pipelineBuilder{};
+        pipelineBuilder.SetComputeShader(shader);
+        pipelineBuilder.pipelineLayout = _cullingPipelineLayout;
+        _cullingPipeline = pipelineBuilder.BuildComputePipeline(device);
+        vkDestroyShaderModule(device, shader, nullptr);
+
+        uint32_t frameCount = SwapChain::MAX_FRAMES_IN_FLIGHT;
+        _descriptorAllocator.CreateDescriptorPool(device,
+                                                  {{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * frameCount},
+                                                   {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCount},
+                                                   {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frameCount}},
+                                                  frameCount);
+        std::vector<VkDescriptorSetLayout> layouts{_cullingSetLayout};
+        std::vector<std::vector<VkDescriptorSet>> sets;
+        _descriptorAllocator.AllocateDescriptorSets(device, layouts, sets);
+        for (size_t i = 0; i < _frames.size(); i++) {
+            _frames[i].cullingSet = sets[i][0];
+        }
+    }
+
+    void GpuScene::WriteCullingSet(FrameBuffers &frame) {
+        DescriptorWriter writer{};
+        writer.WriteBuffer(0, frame.objects.buffer.buffer, VK_WHOLE_SIZE, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.WriteBuffer(1, frame.commands.buffer.buffer, VK_WHOLE_SIZE, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.WriteBuffer(2, frame.counts.buffer.buffer, VK_WHOLE_SIZE, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.WriteBuffer(3, frame.culling.buffer, sizeof(CullingData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+        writer.WriteBuffer(4, _visibility.buffer.buffer, VK_WHOLE_SIZE, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.WriteBuffer(5, frame.stats.buffer, sizeof(CullingStats), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        if (_depthPyramidView != VK_NULL_HANDLE) {
+            writer.WriteImage(6, _depthPyramidView, _depthPyramidSampler, VK_IMAGE_LAYOUT_GENERAL,
+                              VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        }
+        writer.UpdateSet(_device.Device(), frame.cullingSet);
+    }
+} // namespace IC
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "descriptors.h"
+#include "vulkan_allocator.h"
+#include "vulkan_device.h"
+#include "vulkan_types.h"
+
+#include <vector>
+
+namespace IC {
+    // Uniform data of cull_objects.comp, shared by the culling passes of a frame. size = 204 bytes
+    struct CullingData {
+        glm::mat4 view;
+        // frustum planes facing inwards
+        glm::vec4 planes[6];
+        // projection matrix elements [0][0], [1][1], [2][2] and [3][2]
+        glm::vec4 projection;
+        glm::vec3 cameraPosition;
+        uint32_t objectCount;
+        // projected radius in pixels is radius * pixelScale / distance
+        float pixelScale;
+        // objects smaller than this on screen are skipped
+        float minPixelRadius;
+        float nearPlane;
+        // transparent batches come last, the early pass skips them
+        uint32_t firstTransparentBatch;
+    };
+
+    // Objects a culling pass writes draw commands for. Matches the PASS_ constants of cull_objects.comp.
+    enum class CullingPass : uint32_t {
+        // every object in the frustum, without occlusion culling
+        All,
+        // objects that were visible last frame
+        Early,
+        // objects that aren't hidden in the depth pyramid built from the early pass and weren't drawn by it, and all
+        // transparent objects that aren't hidden
+        Late,
+    };
+
+    // written by the late culling pass
+    struct CullingStats {
+        uint32_t occludedObjects;
+        uint32_t occludedTris;
+    };
+
+    // Per frame gpu copies of the object data, which every shader reads its object from, and the gpu driven draw path
+    // built on them. A compute pass culls the objects and writes one indirect draw command per visible object into the
+    // range of its draw batch, so each batch is drawn with a single vkCmdDrawIndexedIndirectCount.
+    //
+    // With occlusion culling a frame is culled in two passes. The early pass draws what was visible last frame, a
+    // depth pyramid is built from the result, and the late pass draws the objects it doesn't hide that the early
+    // pass missed. It also records which objects were visible for the next frame.
+    class GpuScene {
+    public:
+        GpuScene(VulkanDevice &device, VulkanAllocator &allocator);
+        ~GpuScene();
+
+        // False if the device can't draw with gpu written counts. Objects are then culled and drawn from the cpu.
+        bool IsGpuDriven() { return _gpuDriven; }
+
+        // Makes room for the objects and batches of a frame, and for the visibility of every render object. Returns
+        // true if the object buffer was replaced, in which case descriptor sets referring to it have to be rewritten.
+        bool Reserve(size_t frame, uint32_t objectCount, uint32_t batchCount, uint32_t renderObjectCount);
+        GpuObjectData *Objects(size_t frame) {
+            return static_cast<GpuObjectData *>(_frames[frame].objects.buffer.allocInfo.pMappedData);
+        }
+        AllocatedBuffer &ObjectBuffer(size_t frame) { return _frames[frame].objects.buffer; }
+        VkDeviceSize ObjectBufferSize(size_t frame) { return _frames[frame].objects.Size(); }
+
+        // Points the late culling pass at the pyramid. Has to be called whenever the pyramid is resized.
+        void SetDepthPyramid(VkImageView view, VkSampler sampler);
+
+        void SetCullingData(size_t frame, const CullingData &data);
+        // Culls the frame's objects into draw commands, replacing those of the previous pass. Has to be recorded
+        // outside of rendering.
+        void RecordCulling(VkCommandBuffer cBuffer, size_t frame, CullingPass pass, uint32_t batchCount);
+        // valid once the frame's commands have finished
+        const CullingStats &Stats(size_t frame) {
+            _allocator.InvalidateBuffer(_frames[frame].stats);
+            return *static_cast<CullingStats *>(_frames[frame].stats.allocInfo.pMappedData);
+        }
+        // Draws the visible objects of a batch, whose command range starts at firstCommand.
+        void DrawIndirect(VkCommandBuffer cBuffer, size_t frame, uint32_t batch, uint32_t firstCommand,
+                          uint32_t maxDrawCount);
+
+    private:
+        GpuScene(const GpuScene &) = delete;
+        GpuScene &operator=(const GpuScene &) = delete;
+
+        struct FrameBuffers {
+            GrowableBuffer objects{sizeof(GpuObjectData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO};
+            // at most one command per object
+            GrowableBuffer commands{sizeof(VkDrawIndexedIndirectCommand),
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                    VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE};
+            // one per batch
+            GrowableBuffer counts{sizeof(uint32_t),
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE};
+            AllocatedBuffer culling{};
+            AllocatedBuffer stats{};
+            VkDescriptorSet cullingSet = VK_NULL_HANDLE;
+        };
+
+        void CreateCullingPipeline();
+        void WriteCullingSet(FrameBuffers &frame);
+
+        VulkanDevice &_device;
+        VulkanAllocator &_allocator;
+        bool _gpuDriven = false;
+        std::vector<FrameBuffers> _frames;
+        // shared by all frames, as each frame's late pass leaves it for the next one
+        GrowableBuffer _visibility{sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                   VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE};
+        VkImageView _depthPyramidView = VK_NULL_HANDLE;
+        VkSampler _depthPyramidSampler = VK_NULL_HANDLE;
+
+        VkDescriptorSetLayout _cullingSetLayout = VK_NULL_HANDLE;
+        VkPipelineLayout _cullingPipelineLayout = VK_NULL_HANDLE;
+        VkPipeline _cullingPipeline = VK_NULL_HANDLE;
+        DescriptorAllocator _descriptorAllocator{};
+    };
+} // namespace IC
@@ -0,0 +1,160 @@
+#include "light_clusters.h"
+
+#include "swap_chain.h"
+#include "vulkan_constants.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace IC {
+    namespace {
+        constexpr uint32_t CLUSTER_COUNT = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+        uint32_t DepthSlice(float depth, float sliceScale, float sliceBias) {
+            float slice = std::log(depth) * sliceScale + sliceBias;
+            return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(LIGHT_CLUSTERS_Z - 1)));
+        }
+
+        float SliceDepth(uint32_t slice) {
+            return CAMERA_NEAR * std::pow(CAMERA_FAR / CAMERA_NEAR, static_cast<float>(slice) / LIGHT_CLUSTERS_Z);
+        }
+
+        // Finds the tiles along one screen axis covered by the view space interval [min, max] anywhere between two
+        // depths. tanHalfFov is the slope of the frustum along that axis. Returns false if the interval is off screen.
+        bool TileRange(float min, float max, float nearDepth, float farDepth, float tanHalfFov, uint32_t tileCount,
+                       uint32_t &first, uint32_t &last) {
+            // the interval spreads widest on screen at the near depth, on the side it extends to
+            float ndcMin = min / ((min < 0.0f ? nearDepth : farDepth) * tanHalfFov);
+            float ndcMax = max / ((max > 0.0f ? nearDepth : farDepth) * tanHalfFov);
+            if (ndcMin > 1.0f || ndcMax < -1.0f) {
+                return false;
+            }
+
+            float lastTile = static_cast<float>(tileCount - 1);
+            first = static_cast<uint32_t>(std::clamp((ndcMin + 1.0f) * 0.5f * tileCount, 0.0f, lastTile));
+            last = static_cast<uint32_t>(std::clamp((ndcMax + 1.0f) * 0.5f * tileCount, 0.0f, lastTile));
+            return true;
+        }
+    } // namespace
+
+    LightClusters::LightClusters(VulkanAllocator &allocator)
+        : _allocator{allocator}, _frames(SwapChain::MAX_FRAMES_IN_FLIGHT), _clusters(CLUSTER_COUNT) {
+        for (FrameBuffers &buffers : _frames) {
+            _allocator.CreateBuffer(sizeof(SceneLightDescriptors), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                    VMA_MEMORY_USAGE_AUTO, buffers.scene);
+            _allocator.CreateBuffer(CLUSTER_COUNT * sizeof(glm::uvec2), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                    VMA_MEMORY_USAGE_AUTO, buffers.clusters);
+            buffers.lights.Reserve(_allocator, GrowableBuffer::MIN_CAPACITY);
+            buffers.lightIndices.Reserve(_allocator, GrowableBuffer::MIN_CAPACITY);
+        }
+    }
+
+    LightClusters::~LightClusters() {
+        for (FrameBuffers &buffers : _frames) {
+            _allocator.DestroyBuffer(buffers.scene);
+            _allocator.DestroyBuffer(buffers.clusters);
+            buffers.lights.Destroy(_allocator);
+            buffers.lightIndices.Destroy(_allocator);
+        }
+    }
+
+    bool LightClusters::Update(size_t frame, SceneLightDescriptors &scene,
+                               const std::vector<PointLightDescriptors> &lights, VkExtent2D extent) {
+        float sliceRange = std::log(CAMERA_FAR / CAMERA_NEAR);
+        scene.clusterCounts = {LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z};
+        scene.sliceScale = LIGHT_CLUSTERS_Z / sliceRange;
+        scene.sliceBias = -(LIGHT_CLUSTERS_Z * std::log(CAMERA_NEAR)) / sliceRange;
+        scene.clusterSize = {static_cast<float>(extent.width) / LIGHT_CLUSTERS_X,
+                             static_cast<float>(extent.height) / LIGHT_CLUSTERS_Y};
+
+        AssignLights(lights, scene, extent);
+
+        FrameBuffers &buffers = _frames[frame];
+        bool replaced = buffers.lights.Reserve(_allocator, static_cast<uint32_t>(lights.size()));
+        replaced |= buffers.lightIndices.Reserve(_allocator, static_cast<uint32_t>(_lightIndices.size()));
+        memcpy(buffers.scene.allocInfo.pMappedData, &scene, sizeof(SceneLightDescriptors));
+        memcpy(buffers.lights.buffer.allocInfo.pMappedData, lights.data(),
+               lights.size() * sizeof(PointLightDescriptors));
+        memcpy(buffers.clusters.allocInfo.pMappedData, _clusters.data(), CLUSTER_COUNT * sizeof(glm::uvec2));
+        memcpy(buffers.lightIndices.buffer.allocInfo.pMappedData, _lightIndices.data(),
+               _lightIndices.size() * sizeof(uint32_t));
+        return replaced;
+    }
+
+    void LightClusters::WriteDescriptors(DescriptorWriter &writer, size_t frame) {
+        FrameBuffers &buffers = _frames[frame];
+        writer.WriteBuffer(0, buffers.scene.buffer, sizeof(SceneLightDescriptors), 0,
+                           VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+        writer.WriteBuffer(1, buffers.lights.buffer.buffer, buffers.lights.Size(), 0,
+                           VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.WriteBuffer(2, buffers.clusters.buffer, CLUSTER_COUNT * sizeof(glm::uvec2), 0,
+                           VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.WriteBuffer(3, buffers.lightIndices.buffer.buffer, buffers.lightIndices.Size(), 0,
+                           VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    }
+
+    // Counts the lights of each cluster, then lays the clusters' index ranges out back to back and fills them
+    void LightClusters::AssignLights(const std::vector<PointLightDescriptors> &lights,
+                                     const SceneLightDescriptors &scene, VkExtent2D extent) {
+        float tanHalfFovY = std::tan(glm::radians(CAMERA_FOV) * 0.5f);
+        float tanHalfFovX = tanHalfFovY * static_cast<float>(extent.width) / extent.height;
+
+        _lightRects.clear();
+        std::fill(_clusters.begin(), _clusters.end(), glm::uvec2(0));
+        for (uint32_t i = 0; i < lights.size(); i++) {
+            // the camera looks down -z
+            glm::vec3 center = lights[i].pos;
+            float radius = lights[i].range;
+            float minDepth = std::max(-center.z - radius, CAMERA_NEAR);
+            float maxDepth = std::min(-center.z + radius, CAMERA_FAR);
+            if (radius <= 0.0f || minDepth > maxDepth) {
+                continue;
+            }
+
+            uint32_t firstSlice = DepthSlice(minDepth, scene.sliceScale, scene.sliceBias);
+            uint32_t lastSlice = DepthSlice(maxDepth, scene.sliceScale, scene.sliceBias);
+            for (uint32_t slice = firstSlice; slice <= lastSlice; slice++) {
+                float nearDepth = std::max(SliceDepth(slice), minDepth);
+                float farDepth = std::min(SliceDepth(slice + 1), maxDepth);
+
+                // widest cross section of the sphere within the slice
+                float closestDepth = std::clamp(-center.z, nearDepth, farDepth);
+                float offset = closestDepth + center.z;
+                float sectionRadius = std::sqrt(std::max(radius * radius - offset * offset, 0.0f));
+
+                LightRect rect{i, slice};
+                if (!TileRange(center.x - sectionRadius, center.x + sectionRadius, nearDepth, farDepth, tanHalfFovX,
+                               LIGHT_CLUSTERS_X, rect.minX, rect.maxX) ||
+                    !TileRange(center.y - sectionRadius, center.y + sectionRadius, nearDepth, farDepth, tanHalfFovY,
+                               LIGHT_CLUSTERS_Y, rect.minY, rect.maxY)) {
+                    continue;
+                }
+
+                _lightRects.push_back(rect);
+                for (uint32_t y = rect.minY; y <= rect.maxY; y++) {
+                    for (uint32_t x = rect.minX; x <= rect.maxX; x++) {
+                        _clusters[(slice * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x].y++;
+                    }
+                }
+            }
+        }
+
+        uint32_t offset = 0;
+        for (glm::uvec2 &cluster : _clusters) {
+            cluster.x = offset;
+            offset += cluster.y;
+            // counted again while filling
+            cluster.y = 0;
+        }
+
+        _lightIndices.resize(offset);
+        for (const LightRect &rect : _lightRects) {
+            for (uint32_t y = rect.minY; y <= rect.maxY; y++) {
+                for (uint32_t x = rect.minX; x <= rect.maxX; x++) {
+                    glm::uvec2 &cluster = _clusters[(rect.slice * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x];
+                    _lightIndices[cluster.x + cluster.y++] = rect.light;
+                }
+            }
+        }
+    }
+} // namespace IC
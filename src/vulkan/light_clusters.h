@@ -0,0 +1,57 @@
+#pragma once
+
+#include "descriptors.h"
+#include "vulkan_allocator.h"
+#include "vulkan_types.h"
+
+#include <vector>
+
+namespace IC {
+    // Assigns point lights to the clusters of a view space grid, so each fragment only shades the lights of its own
+    // cluster. The grid is tiled on screen and sliced exponentially in depth. It's rebuilt on the cpu every frame into
+    // per frame buffers, which set 1 of every lit object refers to.
+    class LightClusters {
+    public:
+        LightClusters(VulkanAllocator &allocator);
+        ~LightClusters();
+
+        // Assigns the lights to clusters and uploads them along with the scene light data, whose grid parameters are
+        // filled in. Returns true if a buffer was replaced, in which case descriptor sets referring to the frame's
+        // buffers have to be rewritten.
+        bool Update(size_t frame, SceneLightDescriptors &scene, const std::vector<PointLightDescriptors> &lights,
+                    VkExtent2D extent);
+        void WriteDescriptors(DescriptorWriter &writer, size_t frame);
+
+    private:
+        LightClusters(const LightClusters &) = delete;
+        LightClusters &operator=(const LightClusters &) = delete;
+
+        struct FrameBuffers {
+            AllocatedBuffer scene{};
+            GrowableBuffer lights{sizeof(PointLightDescriptors), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                  VMA_MEMORY_USAGE_AUTO};
+            AllocatedBuffer clusters{};
+            GrowableBuffer lightIndices{sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO};
+        };
+
+        // clusters covered by a light within one depth slice
+        struct LightRect {
+            uint32_t light;
+            uint32_t slice;
+            uint32_t minX, maxX;
+            uint32_t minY, maxY;
+        };
+
+        void AssignLights(const std::vector<PointLightDescriptors> &lights, const SceneLightDescriptors &scene,
+                          VkExtent2D extent);
+
+        VulkanAllocator &_allocator;
+        std::vector<FrameBuffers> _frames;
+
+        // assignment scratch, kept to avoid allocating every frame
+        std::vector<LightRect> _lightRects;
+        // offset and light count of each cluster
+        std::vector<glm::uvec2> _clusters;
+        std::vector<uint32_t> _lightIndices;
+    };
+} // namespace IC
@@ -2,16 +2,58 @@
 
 #include <ic_log.h>
 
+#include "descriptors.h"
+#include "ic_job_system.h"
+#include "shader_compiler.h"
 #include "swap_chain.h"
 #include "vulkan_initializers.h"
 #include "vulkan_types.h"
 #include "vulkan_util.h"
 
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <tuple>
 
 namespace IC {
+    namespace {
+        // The sets the renderer writes itself are laid out the same for every pipeline, shaders may use any part of
+        // them. Any object's per object set can be bound with the fallback pipeline this way.
+        DescriptorSetBindings PerObjectBindings() {
+            VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+            return {{0, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, stages}},  // camera
+                    {2, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stages}}}; // objects
+        }
+
+        // The depth prepass runs the material's own vertex shader, so its depth matches the main pass exactly and
+        // the depth only pipeline is rebuilt whenever that shader is reloaded. Both share the layout, so the main
+        // pass keeps the prepass' descriptor sets.
+        std::pair<VkPipeline, VkPipeline> BuildPipelines(VkDevice device, const PipelineKey &key,
+                                                         VkPipelineLayout layout, VkShaderModule vertShader,
+                                                         VkShaderModule fragShader, VkPipelineCache pipelineCache) {
+            VkPipeline pipeline = BuildOpaquePipeline(device, key, layout, vertShader, fragShader, pipelineCache);
+            if (!key.depthPrepass) {
+                return {pipeline, VK_NULL_HANDLE};
+            }
+            try {
+                return {pipeline, BuildDepthOnlyPipeline(device, key, layout, vertShader, pipelineCache)};
+            } catch (std::runtime_error &) {
+                vkDestroyPipeline(device, pipeline, nullptr);
+                throw;
+            }
+        }
+
+        DescriptorSetBindings SceneLightBindings() {
+            return {{0, {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT}},  // directional, grid
+                    {1, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT}},  // point lights
+                    {2, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT}},  // clusters
+                    {3, {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT}}}; // light indices
+        }
+    } // namespace
+
     void PipelineBuilder::clear() {
         inputAssembly = {.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
         rasterizer = {.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
@@ -20,29 +62,18 @@ namespace IC {
         pipelineLayout = {};
         depthStencil = {.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
         renderInfo = {.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR};
+        pipelineCache = VK_NULL_HANDLE;
+        specializationEntries.clear();
+        specializationData.clear();
+        specializationInfo = {};
         shaderStages.clear();
     }
 
-    VkShaderModule PipelineBuilder::CreateShaderModule(VkDevice device, const std::string &filePath) {
-        std::ifstream file{filePath, std::ios::ate | std::ios::binary};
-
-        if (!file.is_open()) {
-            IC_CORE_ERROR("Failed to open file {0}.", filePath);
-            throw std::runtime_error("Failed to open file " + filePath + ".");
-        }
-
-        size_t fileSize = static_cast<size_t>(file.tellg());
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-
-        file.close();
-
+    VkShaderModule PipelineBuilder::CreateShaderModule(VkDevice device, const std::vector<uint32_t> &code) {
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = buffer.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t *>(buffer.data());
+        createInfo.codeSize = code.size() * sizeof(uint32_t);
+        createInfo.pCode = code.data();
 
         VkShaderModule shaderModule;
 
@@ -66,7 +97,8 @@ namespace IC {
         colorBlending.pNext = nullptr;
         colorBlending.logicOpEnable = VK_FALSE;
         colorBlending.logicOp = VK_LOGIC_OP_COPY;
-        colorBlending.attachmentCount = 1;
+        // depth only pipelines have no color attachment
+        colorBlending.attachmentCount = renderInfo.colorAttachmentCount;
         colorBlending.pAttachments = &colorBlendAttachment;
 
         auto bindingDescription = GetVertexBindingDescription();
@@ -78,6 +110,16 @@ namespace IC {
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
         vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
 
+        if (!specializationEntries.empty()) {
+            specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+            specializationInfo.pMapEntries = specializationEntries.data();
+            specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+            specializationInfo.pData = specializationData.data();
+            for (VkPipelineShaderStageCreateInfo &stage : shaderStages) {
+                stage.pSpecializationInfo = &specializationInfo;
+            }
+        }
+
         VkGraphicsPipelineCreateInfo pipelineInfo = {.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
         pipelineInfo.pNext = &renderInfo;
 
@@ -101,7 +143,7 @@ namespace IC {
         pipelineInfo.pDynamicState = &dynamicInfo;
 
         VkPipeline newPipeline;
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+        if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
             IC_CORE_ERROR("Failed to create graphics pipeline.");
             throw std::runtime_error("Failed to create graphics pipeline.");
         }
@@ -116,7 +158,7 @@ namespace IC {
         pipelineInfo.layout = pipelineLayout;
 
         VkPipeline newPipeline;
-        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+        if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
             IC_CORE_ERROR("Failed to create compute pipeline.");
             throw std::runtime_error("Failed to create compute pipeline.");
         }
@@ -129,10 +171,25 @@ namespace IC {
         shaderStages.push_back(ShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader));
     }
 
+    void PipelineBuilder::SetVertexShader(VkShaderModule vertexShader) {
+        shaderStages.clear();
+        shaderStages.push_back(ShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, vertexShader));
+    }
+
     void PipelineBuilder::SetComputeShader(VkShaderModule computeShader) {
         shaderStages.push_back(ShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, computeShader));
     }
 
+    void PipelineBuilder::SetSpecializationConstants(const std::vector<std::pair<uint32_t, uint32_t>> &constants) {
+        specializationEntries.clear();
+        specializationData.clear();
+        for (auto &[constantId, value] : constants) {
+            uint32_t offset = static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t));
+            specializationEntries.push_back({constantId, offset, sizeof(uint32_t)});
+            specializationData.push_back(value);
+        }
+    }
+
     void PipelineBuilder::SetInputTopology(VkPrimitiveTopology topology) {
         inputAssembly.topology = topology;
         inputAssembly.primitiveRestartEnable = VK_FALSE;
@@ -197,10 +254,10 @@ namespace IC {
         depthStencil.maxDepthBounds = 1.f;
     }
 
-    void PipelineBuilder::EnableDepthTest() {
+    void PipelineBuilder::EnableDepthTest(bool depthWrite, VkCompareOp compareOp) {
         depthStencil.depthTestEnable = VK_TRUE;
-        depthStencil.depthWriteEnable = VK_TRUE;
-        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        depthStencil.depthWriteEnable = depthWrite ? VK_TRUE : VK_FALSE;
+        depthStencil.depthCompareOp = compareOp;
         depthStencil.depthBoundsTestEnable = VK_FALSE;
         depthStencil.stencilTestEnable = VK_FALSE;
         depthStencil.front = {};
@@ -219,26 +276,404 @@ namespace IC {
     }
 
     // pipeline manager
+    void PipelineManager::CreatePipelineCache(VulkanDevice &device) {
+        std::vector<char> cacheData;
+        std::ifstream file{PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary};
+        if (file.is_open()) {
+            cacheData.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(cacheData.data(), cacheData.size());
+        }
+
+        // some drivers crash on caches from other devices instead of ignoring them, so stale files are dropped here
+        if (!cacheData.empty() && !IsPipelineCacheCompatible(device, cacheData)) {
+            IC_CORE_WARN("Ignoring pipeline cache {0}, it was written by a different device or driver.",
+                         PIPELINE_CACHE_PATH);
+            cacheData.clear();
+        }
+
+        VkPipelineCacheCreateInfo createInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+        createInfo.initialDataSize = cacheData.size();
+        createInfo.pInitialData = cacheData.data();
+        VK_CHECK(vkCreatePipelineCache(device.Device(), &createInfo, nullptr, &_pipelineCache));
+    }
+
+    void PipelineManager::SavePipelineCache(VulkanDevice &device) {
+        if (_pipelineCache == VK_NULL_HANDLE) {
+            return;
+        }
+
+        size_t size = 0;
+        VK_CHECK(vkGetPipelineCacheData(device.Device(), _pipelineCache, &size, nullptr));
+        std::vector<char> cacheData(size);
+        VK_CHECK(vkGetPipelineCacheData(device.Device(), _pipelineCache, &size, cacheData.data()));
+
+        // written next to the old file first, so a crash while writing can't leave a truncated cache behind
+        std::string temporaryPath = PIPELINE_CACHE_PATH + ".tmp";
+        std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+        if (!file.is_open()) {
+            IC_CORE_WARN("Failed to write pipeline cache {0}.", temporaryPath);
+            return;
+        }
+        file.write(cacheData.data(), size);
+        file.close();
+
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, PIPELINE_CACHE_PATH, error);
+        if (error) {
+            IC_CORE_WARN("Failed to write pipeline cache {0}: {1}", PIPELINE_CACHE_PATH, error.message());
+        }
+    }
+
+    bool PipelineManager::IsPipelineCacheCompatible(VulkanDevice &device, const std::vector<char> &cacheData) {
+        VkPipelineCacheHeaderVersionOne header{};
+        if (cacheData.size() < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, cacheData.data(), sizeof(header));
+
+        return header.headerSize >= sizeof(header) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header.vendorID == device.properties.vendorID && header.deviceID == device.properties.deviceID &&
+               memcmp(header.pipelineCacheUUID, device.properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    void PipelineManager::CreateFallbackPipeline(VkDevice device, SwapChain &swapChain) {
+        PipelineKey key{};
+        key.vertShaderPath = FALLBACK_VERT_SHADER_PATH;
+        key.fragShaderPath = FALLBACK_FRAG_SHADER_PATH;
+        key.materialFlags = MaterialFlags::None;
+        key.colorFormat = swapChain.GetSwapChainImageFormat();
+        key.depthFormat = swapChain.GetSwapChainDepthFormat();
+
+        _fallbackPipeline = std::make_shared<Pipeline>();
+        _fallbackPipeline->id = _nextPipelineId++;
+        _fallbackPipeline->materialFlags = key.materialFlags;
+        _fallbackPipeline->vertShaderPath = key.vertShaderPath;
+        _fallbackPipeline->fragShaderPath = key.fragShaderPath;
+        GetShader(device, key.vertShaderPath);
+        GetShader(device, key.fragShaderPath);
+        if (!CreatePipelineLayouts(device, key, *_fallbackPipeline)) {
+            throw std::runtime_error("Fallback shaders use descriptors other than the per object ones.");
+        }
+        _fallbackPipeline->pipeline =
+            BuildOpaquePipeline(device, key, _fallbackPipeline->layout, GetShaderModule(device, key.vertShaderPath),
+                                GetShaderModule(device, key.fragShaderPath), _pipelineCache);
+        _pipelines[key] = _fallbackPipeline;
+    }
+
     void PipelineManager::DestroyPipelines(VkDevice device) {
-        for (auto pipeline : _createdPipelines) {
+        CollectBuilds(device, true);
+        for (auto &[key, pipeline] : _pipelines) {
             DestroyPipeline(device, *pipeline);
         }
+        _pipelines.clear();
+        for (auto &[key, pipelineLayout] : _pipelineLayouts) {
+            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        }
+        _pipelineLayouts.clear();
+        for (auto &[bindings, setLayout] : _descriptorSetLayouts) {
+            vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+        }
+        _descriptorSetLayouts.clear();
+        for (auto &[path, shader] : _shaders) {
+            vkDestroyShaderModule(device, shader.module, nullptr);
+        }
+        _shaders.clear();
+        vkDestroyPipelineCache(device, _pipelineCache, nullptr);
+        _pipelineCache = VK_NULL_HANDLE;
     }
 
     std::shared_ptr<Pipeline> PipelineManager::FindOrCreateSuitablePipeline(VkDevice device, SwapChain &swapChain,
-                                                                            MaterialInstance &materialData) {
-        for (auto pipeline : _createdPipelines) {
-            if (IsPipelineSuitable(*pipeline, materialData)) {
-                return pipeline;
-            }
+                                                                            MaterialInstance &materialData,
+                                                                            bool depthPrepass) {
+        PipelineKey key = MakePipelineKey(swapChain, materialData, depthPrepass);
+        auto it = _pipelines.find(key);
+        if (it != _pipelines.end()) {
+            return it->second;
         }
-        std::shared_ptr<Pipeline> pipeline = CreateOpaquePipeline(device, swapChain, materialData);
-        _createdPipelines.push_back(pipeline);
+
+        std::shared_ptr<Pipeline> pipeline = std::make_shared<Pipeline>();
+        pipeline->id = _nextPipelineId++;
+        pipeline->materialFlags = key.materialFlags;
+        pipeline->vertShaderPath = key.vertShaderPath;
+        pipeline->fragShaderPath = key.fragShaderPath;
+        _pipelines[key] = pipeline;
+
+        RequestShader(device, key.vertShaderPath);
+        RequestShader(device, key.fragShaderPath);
+        _pendingLayouts.push_back(key);
         return pipeline;
     }
 
-    bool PipelineManager::IsPipelineSuitable(Pipeline &pipeline, MaterialInstance &materialData) {
-        // todo: oversimplification, but will do for now
-        return pipeline.materialFlags == materialData.Template().flags;
+    void PipelineManager::Update(VkDevice device) {
+        CollectBuilds(device, false);
+    }
+
+    void PipelineManager::RequestShader(VkDevice device, const std::string &shaderPath) {
+        if (_shaders.contains(shaderPath) || _pendingShaders.contains(shaderPath)) {
+            return;
+        }
+        _pendingShaders[shaderPath] =
+            JobSystem::Submit([device, shaderPath]() { return CreateShader(device, shaderPath); }).share();
+    }
+
+    void PipelineManager::CollectShaders(bool wait) {
+        for (auto it = _pendingShaders.begin(); it != _pendingShaders.end();) {
+            if (!wait && it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+
+            try {
+                _shaders[it->first] = it->second.get();
+            } catch (std::runtime_error &) {
+                IC_CORE_ERROR("Failed to load shader {0}.", it->first);
+            }
+            it = _pendingShaders.erase(it);
+        }
+    }
+
+    void PipelineManager::CollectBuilds(VkDevice device, bool wait) {
+        CollectShaders(wait);
+
+        // layouts need the shaders' reflection, and are created here as the caches are only used on this thread
+        for (auto it = _pendingLayouts.begin(); it != _pendingLayouts.end();) {
+            const PipelineKey &key = *it;
+            if (_pendingShaders.contains(key.vertShaderPath) || _pendingShaders.contains(key.fragShaderPath)) {
+                ++it;
+                continue;
+            }
+
+            // the pipeline is never built, so its objects keep being drawn with the fallback pipeline
+            Pipeline &pipeline = *_pipelines.at(key);
+            if (!_shaders.contains(key.vertShaderPath) || !_shaders.contains(key.fragShaderPath) ||
+                !CreatePipelineLayouts(device, key, pipeline)) {
+                IC_CORE_ERROR("Objects using {0} and {1} are drawn with the fallback pipeline.", key.vertShaderPath,
+                              key.fragShaderPath);
+            } else {
+                VkShaderModule vertShader = _shaders[key.vertShaderPath].module;
+                VkShaderModule fragShader = _shaders[key.fragShaderPath].module;
+                pipeline.pendingBuild = JobSystem::Submit([device, key, layout = pipeline.layout, vertShader,
+                                                           fragShader, pipelineCache = _pipelineCache]() {
+                    return BuildPipelines(device, key, layout, vertShader, fragShader, pipelineCache);
+                });
+            }
+            it = _pendingLayouts.erase(it);
+        }
+
+        for (auto &[key, pipeline] : _pipelines) {
+            if (!pipeline->pendingBuild.valid() ||
+                (!wait && pipeline->pendingBuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready)) {
+                continue;
+            }
+
+            try {
+                std::tie(pipeline->pipeline, pipeline->depthPipeline) = pipeline->pendingBuild.get();
+            } catch (std::runtime_error &) {
+                IC_CORE_ERROR("Failed to compile pipeline for {0} and {1}, its objects are drawn with the fallback "
+                              "pipeline.",
+                              key.vertShaderPath, key.fragShaderPath);
+            }
+        }
+    }
+
+    VkShaderModule PipelineManager::GetShaderModule(VkDevice device, const std::string &shaderPath) {
+        return GetShader(device, shaderPath).module;
+    }
+
+    PipelineManager::Shader PipelineManager::CreateShader(VkDevice device, const std::string &shaderPath) {
+        std::vector<uint32_t> code = LoadShaderCode(shaderPath);
+
+        Shader shader{};
+        if (!ReflectShader(code, shader.layout)) {
+            IC_CORE_ERROR("Failed to reflect shader {0}.", shaderPath);
+            throw std::runtime_error("Failed to reflect shader " + shaderPath + ".");
+        }
+        shader.module = PipelineBuilder::CreateShaderModule(device, code);
+        return shader;
+    }
+
+    PipelineManager::Shader &PipelineManager::GetShader(VkDevice device, const std::string &shaderPath) {
+        auto it = _shaders.find(shaderPath);
+        if (it != _shaders.end()) {
+            return it->second;
+        }
+        return _shaders[shaderPath] = CreateShader(device, shaderPath);
+    }
+
+    bool PipelineManager::CreatePipelineLayouts(VkDevice device, const PipelineKey &key, Pipeline &pipeline) {
+        ShaderLayout shaderLayout = _shaders.at(key.vertShaderPath).layout;
+        shaderLayout.Merge(_shaders.at(key.fragShaderPath).layout);
+
+        // sets in the order the renderer writes them
+        std::vector<DescriptorSetBindings> sets{PerObjectBindings()};
+        if (key.materialFlags & MaterialFlags::Lit) {
+            sets.push_back(SceneLightBindings());
+        }
+        size_t materialSet = sets.size();
+        if (!key.materialBindings.empty()) {
+            DescriptorSetBindings &material = sets.emplace_back();
+            for (auto &[index, bindingType] : key.materialBindings) {
+                material[index] = {bindingType == BindingType::Texture ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                                                       : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                   1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT};
+            }
+        }
+
+        bool matches = true;
+        for (auto &[set, bindings] : shaderLayout.sets) {
+            for (auto &[index, binding] : bindings) {
+                if (set >= sets.size() || !sets[set].contains(index) || sets[set][index].type != binding.type ||
+                    sets[set][index].count != binding.count) {
+                    IC_CORE_ERROR("{0} and {1} declare set {2}, binding {3}, which doesn't match the material.",
+                                  key.vertShaderPath, key.fragShaderPath, set, index);
+                    matches = false;
+                } else if (set == materialSet) {
+                    // material bindings are only visible to the stages reading them
+                    sets[set][index].stages = binding.stages;
+                }
+            }
+        }
+        // per object data comes from the object buffer, nothing is pushed
+        if (shaderLayout.pushConstantSize > 0) {
+            IC_CORE_ERROR("{0} and {1} declare {2} bytes of push constants, but none are pushed.", key.vertShaderPath,
+                          key.fragShaderPath, shaderLayout.pushConstantSize);
+            matches = false;
+        }
+
+        pipeline.descriptorSetLayouts.clear();
+        for (const DescriptorSetBindings &bindings : sets) {
+            pipeline.descriptorSetLayouts.push_back(GetDescriptorSetLayout(device, bindings));
+        }
+        pipeline.pushConstants = {shaderLayout.pushConstantStages, 0, shaderLayout.pushConstantSize};
+        pipeline.layout = GetPipelineLayout(device, pipeline.descriptorSetLayouts, pipeline.pushConstants);
+        return matches;
+    }
+
+    VkDescriptorSetLayout PipelineManager::GetDescriptorSetLayout(VkDevice device,
+                                                                  const DescriptorSetBindings &bindings) {
+        auto it = _descriptorSetLayouts.find(bindings);
+        if (it != _descriptorSetLayouts.end()) {
+            return it->second;
+        }
+
+        DescriptorLayoutBuilder descriptorLayoutBuilder{};
+        for (auto &[index, binding] : bindings) {
+            descriptorLayoutBuilder.AddBinding(index, binding.type, binding.stages, binding.count);
+        }
+        return _descriptorSetLayouts[bindings] = descriptorLayoutBuilder.Build(device, 0);
+    }
+
+    VkPipelineLayout PipelineManager::GetPipelineLayout(VkDevice device,
+                                                        const std::vector<VkDescriptorSetLayout> &setLayouts,
+                                                        VkPushConstantRange pushConstants) {
+        PipelineLayoutKey key{setLayouts, pushConstants.size, pushConstants.stageFlags};
+        auto it = _pipelineLayouts.find(key);
+        if (it != _pipelineLayouts.end()) {
+            return it->second;
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        if (pushConstants.size > 0) {
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
+        }
+
+        VkPipelineLayout pipelineLayout;
+        VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+        return _pipelineLayouts[key] = pipelineLayout;
+    }
+
+    void PipelineManager::ReloadShader(VkDevice device, const std::string &shaderPath) {
+        auto cached = _shaders.find(shaderPath);
+        if (cached == _shaders.end()) {
+            return;
+        }
+
+        // background compiles may still be reading the module that is about to be replaced
+        CollectBuilds(device, true);
+
+        // a broken shader leaves the current module and pipelines untouched
+        Shader shader;
+        try {
+            shader = CreateShader(device, shaderPath);
+        } catch (std::runtime_error &) {
+            IC_CORE_ERROR("Failed to reload shader {0}.", shaderPath);
+            return;
+        }
+
+        // pipelines keep working after their modules are destroyed, so the old module can go right away
+        vkDestroyShaderModule(device, cached->second.module, nullptr);
+        cached->second = shader;
+
+        for (auto &[key, pipeline] : _pipelines) {
+            // pipelines whose other shader failed to load were never built
+            if ((key.vertShaderPath != shaderPath && key.fragShaderPath != shaderPath) ||
+                !_shaders.contains(key.vertShaderPath) || !_shaders.contains(key.fragShaderPath)) {
+                continue;
+            }
+
+            // layouts are shared, so an unchanged interface gives back the very same pipeline layout
+            Pipeline reloaded{};
+            if (!CreatePipelineLayouts(device, key, reloaded) || reloaded.layout != pipeline->layout) {
+                IC_CORE_ERROR("Reloaded {0} changes the resources it declares, restart to apply the change.",
+                              shaderPath);
+                continue;
+            }
+
+            // a failed build leaves the current pipeline untouched
+            std::pair<VkPipeline, VkPipeline> rebuilt;
+            try {
+                rebuilt = BuildPipelines(device, key, pipeline->layout, _shaders[key.vertShaderPath].module,
+                                         _shaders[key.fragShaderPath].module, _pipelineCache);
+            } catch (std::runtime_error &) {
+                IC_CORE_ERROR("Failed to rebuild pipeline for {0}.", shaderPath);
+                continue;
+            }
+
+            DestroyPipeline(device, *pipeline);
+            std::tie(pipeline->pipeline, pipeline->depthPipeline) = rebuilt;
+        }
+    }
+
+    PipelineKey PipelineManager::MakePipelineKey(SwapChain &swapChain, MaterialInstance &materialData,
+                                                 bool depthPrepass) {
+        PipelineKey key{};
+        key.vertShaderPath = materialData.Template().vertShaderData;
+        key.fragShaderPath = materialData.Template().fragShaderData;
+        key.materialFlags = materialData.Template().flags;
+        for (auto &[index, binding] : materialData.BindingValues()) {
+            key.materialBindings.push_back({index, binding.binding->bindingType});
+        }
+        for (auto &[constantId, variantKey] : materialData.Template().VariantKeys()) {
+            key.specializationConstants.push_back({constantId, materialData.VariantValue(constantId)});
+        }
+        key.colorFormat = swapChain.GetSwapChainImageFormat();
+        key.depthFormat = swapChain.GetSwapChainDepthFormat();
+        key.depthPrepass = depthPrepass;
+        return key;
+    }
+
+    size_t PipelineKeyHash::operator()(const PipelineKey &key) const {
+        size_t hash = 0;
+        auto combine = [&hash](size_t value) { hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2); };
+
+        combine(std::hash<std::string>{}(key.vertShaderPath));
+        combine(std::hash<std::string>{}(key.fragShaderPath));
+        combine(static_cast<size_t>(key.materialFlags));
+        for (auto &[index, bindingType] : key.materialBindings) {
+            combine(static_cast<size_t>(index));
+            combine(static_cast<size_t>(bindingType));
+        }
+        for (auto &[constantId, value] : key.specializationConstants) {
+            combine(static_cast<size_t>(constantId));
+            combine(static_cast<size_t>(value));
+        }
+        combine(static_cast<size_t>(key.colorFormat));
+        combine(static_cast<size_t>(key.depthFormat));
+        combine(static_cast<size_t>(key.depthPrepass));
+        return hash;
     }
 } // namespace IC
@@ -1,10 +1,16 @@
 #pragma once
 
+#include "shader_reflection.h"
 #include "swap_chain.h"
 #include "vulkan_device.h"
 #include "vulkan_types.h"
 
+#include <future>
+#include <map>
 #include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 
 namespace IC {
     class PipelineBuilder {
@@ -19,16 +25,24 @@ namespace IC {
         VkPipelineDepthStencilStateCreateInfo depthStencil;
         VkPipelineRenderingCreateInfo renderInfo;
         VkFormat colorAttachmentformat;
+        VkPipelineCache pipelineCache;
+        std::vector<VkSpecializationMapEntry> specializationEntries;
+        std::vector<uint32_t> specializationData;
+        VkSpecializationInfo specializationInfo;
 
         PipelineBuilder() { clear(); }
-        static VkShaderModule CreateShaderModule(VkDevice device, const std::string &filePath);
+        static VkShaderModule CreateShaderModule(VkDevice device, const std::vector<uint32_t> &code);
 
         void clear();
 
         VkPipeline BuildPipeline(VkDevice device);
         VkPipeline BuildComputePipeline(VkDevice device);
         void SetShaders(VkShaderModule vertexShader, VkShaderModule fragmentShader);
+        // for depth only pipelines
+        void SetVertexShader(VkShaderModule vertexShader);
         void SetComputeShader(VkShaderModule computeShader);
+        // 32 bit constant id and value pairs, applied to every shader stage
+        void SetSpecializationConstants(const std::vector<std::pair<uint32_t, uint32_t>> &constants);
         void SetInputTopology(VkPrimitiveTopology topology);
         void SetPolygonMode(VkPolygonMode mode);
         void SetCullMode(VkCullModeFlags cullMode, VkFrontFace frontFace);
@@ -38,21 +52,107 @@ namespace IC {
         void SetColorAttachmentFormat(VkFormat format);
         void SetDepthFormat(VkFormat format);
         void DisableDepthTest();
-        void EnableDepthTest();
+        void EnableDepthTest(bool depthWrite = true, VkCompareOp compareOp = VK_COMPARE_OP_LESS);
 
     private:
         static VkPipelineShaderStageCreateInfo ShaderStageCreateInfo(VkShaderStageFlagBits flags,
                                                                      VkShaderModule module);
     };
 
+    // Everything two pipelines can differ in. Blend state follows from the material flags, and all meshes share one
+    // vertex layout.
+    struct PipelineKey {
+        std::string vertShaderPath;
+        std::string fragShaderPath;
+        MaterialFlags materialFlags;
+        // material binding indices and types, which make up the material descriptor set layout
+        std::vector<std::pair<int, BindingType>> materialBindings;
+        // material variant constant ids and values
+        std::vector<std::pair<uint32_t, uint32_t>> specializationConstants;
+        VkFormat colorFormat;
+        VkFormat depthFormat;
+        // depth was laid down by the pipeline's depth only variant, so only fragments at exactly that depth are shaded
+        bool depthPrepass = false;
+
+        bool operator==(const PipelineKey &other) const = default;
+    };
+
+    struct PipelineKeyHash {
+        size_t operator()(const PipelineKey &key) const;
+    };
+
     class PipelineManager {
     public:
+        // Creates the pipeline cache, seeded from the file written by the previous run if it was written by the same
+        // driver and device.
+        void CreatePipelineCache(VulkanDevice &device);
+        // Writes the pipeline cache to disk, so the next run skips compiling pipelines it has seen before
+        void SavePipelineCache(VulkanDevice &device);
+
+        // Compiles the pipeline drawn in place of pipelines that are not ready yet. Blocks until it is done.
+        void CreateFallbackPipeline(VkDevice device, SwapChain &swapChain);
+        Pipeline &FallbackPipeline() { return *_fallbackPipeline; }
+
+        // Destroys all pipelines and the pipeline cache
         void DestroyPipelines(VkDevice device);
+
+        // Returns right away. The shaders of new pipelines are compiled and reflected on the job system, their
+        // layouts are created by a later Update() and the pipeline is then built on the job system as well. Until it
+        // is ready, and for good if a shader fails to compile, objects are drawn with the fallback pipeline.
         std::shared_ptr<Pipeline> FindOrCreateSuitablePipeline(VkDevice device, SwapChain &swapChain,
-                                                               MaterialInstance &materialData);
+                                                               MaterialInstance &materialData,
+                                                               bool depthPrepass = false);
+
+        // Picks up shaders and pipelines that have finished compiling
+        void Update(VkDevice device);
+
+        // Shader modules are created once per file and shared by every pipeline using them
+        VkShaderModule GetShaderModule(VkDevice device, const std::string &shaderPath);
+
+        // Rebuilds every pipeline that uses the shader file. Pipelines are swapped in place, so render objects
+        // keep their references. A shader whose resources changed is not swapped in, as existing descriptor sets
+        // were allocated for the old layouts. Must be called while no frame is in flight.
+        void ReloadShader(VkDevice device, const std::string &shaderPath);
 
     private:
-        bool IsPipelineSuitable(Pipeline &pipeline, MaterialInstance &materialData);
-        std::vector<std::shared_ptr<Pipeline>> _createdPipelines;
+        struct Shader {
+            VkShaderModule module;
+            ShaderLayout layout;
+        };
+
+        // descriptor set layouts and push constant range
+        using PipelineLayoutKey = std::tuple<std::vector<VkDescriptorSetLayout>, uint32_t, VkShaderStageFlags>;
+
+        static Shader CreateShader(VkDevice device, const std::string &shaderPath);
+        Shader &GetShader(VkDevice device, const std::string &shaderPath);
+        // Starts compiling a shader on the job system, unless it is loaded or already compiling
+        void RequestShader(VkDevice device, const std::string &shaderPath);
+        // Creates the layouts of a pipeline from what its shaders declare. Returns false if the shaders don't match
+        // the descriptors the renderer writes for the material, the layouts then follow the material.
+        bool CreatePipelineLayouts(VkDevice device, const PipelineKey &key, Pipeline &pipeline);
+        // Layouts are shared by every pipeline declaring the same resources
+        VkDescriptorSetLayout GetDescriptorSetLayout(VkDevice device, const DescriptorSetBindings &bindings);
+        VkPipelineLayout GetPipelineLayout(VkDevice device, const std::vector<VkDescriptorSetLayout> &setLayouts,
+                                           VkPushConstantRange pushConstants);
+        void CollectShaders(bool wait);
+        void CollectBuilds(VkDevice device, bool wait);
+        static PipelineKey MakePipelineKey(SwapChain &swapChain, MaterialInstance &materialData, bool depthPrepass);
+        static bool IsPipelineCacheCompatible(VulkanDevice &device, const std::vector<char> &cacheData);
+
+        const std::string PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+        const std::string FALLBACK_VERT_SHADER_PATH = "resources/shaders/fallback_shader.vert";
+        const std::string FALLBACK_FRAG_SHADER_PATH = "resources/shaders/fallback_shader.frag";
+
+        std::unordered_map<PipelineKey, std::shared_ptr<Pipeline>, PipelineKeyHash> _pipelines;
+        std::unordered_map<std::string, Shader> _shaders;
+        // shared by every pipeline waiting for the shader. Shaders that failed are dropped, so they are in neither map.
+        std::unordered_map<std::string, std::shared_future<Shader>> _pendingShaders;
+        // pipelines whose layouts wait for their shaders
+        std::vector<PipelineKey> _pendingLayouts;
+        std::map<DescriptorSetBindings, VkDescriptorSetLayout> _descriptorSetLayouts;
+        std::map<PipelineLayoutKey, VkPipelineLayout> _pipelineLayouts;
+        VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+        std::shared_ptr<Pipeline> _fallbackPipeline;
+        uint32_t _nextPipelineId = 0;
     };
 } // namespace IC
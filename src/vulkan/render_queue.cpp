@@ -0,0 +1,57 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <array>
+
+namespace IC {
+    namespace {
+        constexpr uint64_t DEPTH_MAX = 0xFFFF;
+    } // namespace
+
+    uint64_t RenderQueue::MakeKey(RenderPass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+        uint64_t depthBits = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * DEPTH_MAX);
+        uint64_t state = (static_cast<uint64_t>(pipeline & 0x3FFF) << 32) |
+                         (static_cast<uint64_t>(material & 0xFFFF) << 16) | static_cast<uint64_t>(mesh & 0xFFFF);
+        uint64_t passBits = static_cast<uint64_t>(pass) << 62;
+
+        if (pass == RenderPass::Transparent) {
+            // blending needs the farthest objects first, so depth comes before state
+            return passBits | ((DEPTH_MAX - depthBits) << 46) | state;
+        }
+        return passBits | (state << 16) | depthBits;
+    }
+
+    void RenderQueue::Sort() {
+        if (_commands.empty()) {
+            return;
+        }
+
+        uint64_t differingBits = 0;
+        for (const RenderCommand &command : _commands) {
+            differingBits |= command.key ^ _commands[0].key;
+        }
+
+        _sorted.resize(_commands.size());
+        for (uint32_t shift = 0; shift < 64; shift += 8) {
+            if (((differingBits >> shift) & 0xFF) == 0) {
+                continue;
+            }
+
+            std::array<uint32_t, 256> offsets{};
+            for (const RenderCommand &command : _commands) {
+                offsets[(command.key >> shift) & 0xFF]++;
+            }
+            uint32_t offset = 0;
+            for (uint32_t &count : offsets) {
+                uint32_t bucketSize = count;
+                count = offset;
+                offset += bucketSize;
+            }
+
+            for (const RenderCommand &command : _commands) {
+                _sorted[offsets[(command.key >> shift) & 0xFF]++] = command;
+            }
+            _commands.swap(_sorted);
+        }
+    }
+} // namespace IC
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace IC {
+    enum class RenderPass : uint8_t { Opaque = 0, Transparent = 1 };
+
+    struct RenderCommand {
+        uint64_t key;
+        // index of the render object
+        uint32_t object;
+    };
+
+    // Draws of one frame, sorted by packed keys so that draws sharing state end up next to each other.
+    //   opaque:      pass:2 | pipeline:14 | material:16 | mesh:16 | depth:16, grouped by state, then front to back
+    //   transparent: pass:2 | inverted depth:16 | pipeline:14 | material:16 | mesh:16, back to front
+    // Ids wider than their field wrap around, which only costs some grouping.
+    class RenderQueue {
+    public:
+        // depth is the view space distance normalized to [0, 1]
+        static uint64_t MakeKey(RenderPass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+        void Clear() { _commands.clear(); }
+        void Push(uint64_t key, uint32_t object) { _commands.push_back({key, object}); }
+
+        // LSD radix sort on the keys, 8 bits per pass. Bytes that are the same in every key are skipped.
+        void Sort();
+
+        const std::vector<RenderCommand> &Commands() { return _commands; }
+
+    private:
+        std::vector<RenderCommand> _commands;
+        std::vector<RenderCommand> _sorted;
+    };
+} // namespace IC
@@ -0,0 +1,191 @@
+#include "shader_compiler.h"
+
+#include <ic_common.h>
+#include <ic_log.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef IC_RUNTIME_SHADER_COMPILER
+#include <shaderc/shaderc.hpp>
+
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#endif
+
+namespace IC {
+    namespace {
+        std::vector<uint32_t> ReadSpirv(const std::string &path) {
+            std::ifstream file{path, std::ios::ate | std::ios::binary};
+            if (!file.is_open()) {
+                IC_CORE_ERROR("Failed to open file {0}.", path);
+                throw std::runtime_error("Failed to open file " + path + ".");
+            }
+
+            size_t fileSize = static_cast<size_t>(file.tellg());
+            if (fileSize % sizeof(uint32_t) != 0) {
+                IC_CORE_ERROR("{0} is not a SPIR-V file.", path);
+                throw std::runtime_error(path + " is not a SPIR-V file.");
+            }
+
+            std::vector<uint32_t> code(fileSize / sizeof(uint32_t));
+            file.seekg(0);
+            file.read(reinterpret_cast<char *>(code.data()), fileSize);
+            return code;
+        }
+
+#ifdef IC_RUNTIME_SHADER_COMPILER
+        const std::string SHADER_CACHE_DIRECTORY = "shader_cache";
+        // part of every cache key, change it whenever the compile options below change
+        const std::string COMPILE_OPTIONS_TAG = "vulkan1.3;performance";
+
+        std::string ReadText(const std::string &path) {
+            std::ifstream file{path, std::ios::binary};
+            if (!file.is_open()) {
+                return {};
+            }
+            return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        }
+
+        bool ShaderKind(const std::string &path, shaderc_shader_kind &kind) {
+            std::string extension = std::filesystem::path(path).extension().string();
+            if (extension == ".vert") {
+                kind = shaderc_vertex_shader;
+            } else if (extension == ".frag") {
+                kind = shaderc_fragment_shader;
+            } else if (extension == ".comp") {
+                kind = shaderc_compute_shader;
+            } else if (extension == ".geom") {
+                kind = shaderc_geometry_shader;
+            } else if (extension == ".tesc") {
+                kind = shaderc_tess_control_shader;
+            } else if (extension == ".tese") {
+                kind = shaderc_tess_evaluation_shader;
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        // Resolves #include relative to the including file.
+        class FileIncluder : public shaderc::CompileOptions::IncluderInterface {
+        public:
+            shaderc_include_result *GetInclude(const char *requestedSource, shaderc_include_type type,
+                                               const char *requestingSource, size_t) override {
+                auto include = std::make_unique<Include>();
+                std::filesystem::path path = requestedSource;
+                if (type == shaderc_include_type_relative) {
+                    path = std::filesystem::path(requestingSource).parent_path() / requestedSource;
+                }
+                include->path = path.string();
+                include->content = ReadText(include->path);
+                if (include->content.empty()) {
+                    // an empty source name reports the content as the error
+                    include->content = "Failed to open " + include->path + ".";
+                    include->path.clear();
+                }
+
+                include->result.source_name = include->path.c_str();
+                include->result.source_name_length = include->path.size();
+                include->result.content = include->content.c_str();
+                include->result.content_length = include->content.size();
+                include->result.user_data = include.get();
+                return &include.release()->result;
+            }
+
+            void ReleaseInclude(shaderc_include_result *result) override {
+                delete static_cast<Include *>(result->user_data);
+            }
+
+        private:
+            struct Include {
+                shaderc_include_result result;
+                std::string path;
+                std::string content;
+            };
+        };
+
+        std::vector<uint32_t> CompileShader(const std::string &path) {
+            shaderc_shader_kind kind;
+            if (!ShaderKind(path, kind)) {
+                IC_CORE_ERROR("Can't tell the shader stage of {0} from its extension.", path);
+                throw std::runtime_error("Unknown shader stage of " + path + ".");
+            }
+
+            std::string source = ReadText(path);
+            if (source.empty()) {
+                IC_CORE_ERROR("Failed to open file {0}.", path);
+                throw std::runtime_error("Failed to open file " + path + ".");
+            }
+
+            shaderc::Compiler compiler;
+            shaderc::CompileOptions options;
+            options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+            options.SetOptimizationLevel(shaderc_optimization_level_performance);
+            options.SetIncluder(std::make_unique<FileIncluder>());
+
+            // includes and macros are resolved first, so the hash covers everything that affects the output
+            shaderc::PreprocessedSourceCompilationResult preprocessed =
+                compiler.PreprocessGlsl(source, kind, path.c_str(), options);
+            if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success) {
+                IC_CORE_ERROR("Failed to compile shader {0}:\n{1}", path, preprocessed.GetErrorMessage());
+                throw std::runtime_error("Failed to compile shader " + path + ".");
+            }
+            std::string preprocessedSource{preprocessed.cbegin(), preprocessed.cend()};
+
+            char hash[17];
+            snprintf(hash, sizeof(hash), "%016llx",
+                     static_cast<unsigned long long>(HashText(COMPILE_OPTIONS_TAG + '\n' + preprocessedSource)));
+            std::filesystem::path cachePath = std::filesystem::path(SHADER_CACHE_DIRECTORY) / hash;
+            cachePath += ".spv";
+            if (std::filesystem::exists(cachePath)) {
+                return ReadSpirv(cachePath.string());
+            }
+
+            shaderc::SpvCompilationResult result =
+                compiler.CompileGlslToSpv(preprocessedSource, kind, path.c_str(), options);
+            if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+                IC_CORE_ERROR("Failed to compile shader {0}:\n{1}", path, result.GetErrorMessage());
+                throw std::runtime_error("Failed to compile shader " + path + ".");
+            }
+            std::vector<uint32_t> code{result.cbegin(), result.cend()};
+
+            // written next to the final file first, so a crash while writing can't leave a truncated entry behind
+            std::error_code error;
+            std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+            std::filesystem::path temporaryPath = cachePath;
+            temporaryPath += ".tmp";
+            std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+            if (file.is_open()) {
+                file.write(reinterpret_cast<const char *>(code.data()), code.size() * sizeof(uint32_t));
+                file.close();
+                std::filesystem::rename(temporaryPath, cachePath, error);
+            }
+            if (!file.good() || error) {
+                IC_CORE_WARN("Failed to write shader cache entry {0}.", cachePath.string());
+            }
+
+            return code;
+        }
+#endif
+    } // namespace
+
+    std::string ShaderFilePath(const std::string &shaderPath) {
+#ifdef IC_RUNTIME_SHADER_COMPILER
+        return shaderPath;
+#else
+        return shaderPath.ends_with(".spv") ? shaderPath : shaderPath + ".spv";
+#endif
+    }
+
+    std::vector<uint32_t> LoadShaderCode(const std::string &shaderPath) {
+#ifdef IC_RUNTIME_SHADER_COMPILER
+        if (!shaderPath.ends_with(".spv")) {
+            return CompileShader(shaderPath);
+        }
+#endif
+        return ReadSpirv(ShaderFilePath(shaderPath));
+    }
+} // namespace IC
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace IC {
+    // Materials may refer to GLSL sources or to SPIR-V files ending in .spv. Sources are compiled at runtime when the
+    // engine is built with IC_RUNTIME_SHADER_COMPILER, with the SPIR-V cached on disk by a hash of the preprocessed
+    // source. Otherwise the .spv file the build compiled next to the source is loaded instead.
+
+    // Returns the file a shader is loaded from, which is the one to watch for changes.
+    std::string ShaderFilePath(const std::string &shaderPath);
+
+    // Throws std::runtime_error if the shader can't be read or fails to compile.
+    std::vector<uint32_t> LoadShaderCode(const std::string &shaderPath);
+} // namespace IC
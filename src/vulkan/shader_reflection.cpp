@@ -0,0 +1,288 @@
+#include "shader_reflection.h"
+
+#include <ic_log.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace IC {
+    namespace {
+        constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+        constexpr size_t SPIRV_HEADER_WORDS = 5;
+
+        // opcodes, decorations and enums, see the SPIR-V specification
+        constexpr uint32_t OP_ENTRY_POINT = 15;
+        constexpr uint32_t OP_TYPE_BOOL = 20;
+        constexpr uint32_t OP_TYPE_INT = 21;
+        constexpr uint32_t OP_TYPE_FLOAT = 22;
+        constexpr uint32_t OP_TYPE_VECTOR = 23;
+        constexpr uint32_t OP_TYPE_MATRIX = 24;
+        constexpr uint32_t OP_TYPE_IMAGE = 25;
+        constexpr uint32_t OP_TYPE_SAMPLER = 26;
+        constexpr uint32_t OP_TYPE_SAMPLED_IMAGE = 27;
+        constexpr uint32_t OP_TYPE_ARRAY = 28;
+        constexpr uint32_t OP_TYPE_RUNTIME_ARRAY = 29;
+        constexpr uint32_t OP_TYPE_STRUCT = 30;
+        constexpr uint32_t OP_TYPE_POINTER = 32;
+        constexpr uint32_t OP_CONSTANT = 43;
+        constexpr uint32_t OP_SPEC_CONSTANT = 50;
+        constexpr uint32_t OP_VARIABLE = 59;
+        constexpr uint32_t OP_DECORATE = 71;
+        constexpr uint32_t OP_MEMBER_DECORATE = 72;
+
+        constexpr uint32_t DECORATION_BUFFER_BLOCK = 3;
+        constexpr uint32_t DECORATION_ARRAY_STRIDE = 6;
+        constexpr uint32_t DECORATION_MATRIX_STRIDE = 7;
+        constexpr uint32_t DECORATION_BINDING = 33;
+        constexpr uint32_t DECORATION_DESCRIPTOR_SET = 34;
+        constexpr uint32_t DECORATION_OFFSET = 35;
+
+        constexpr uint32_t STORAGE_CLASS_UNIFORM_CONSTANT = 0;
+        constexpr uint32_t STORAGE_CLASS_UNIFORM = 2;
+        constexpr uint32_t STORAGE_CLASS_PUSH_CONSTANT = 9;
+        constexpr uint32_t STORAGE_CLASS_STORAGE_BUFFER = 12;
+
+        constexpr uint32_t DIM_BUFFER = 5;
+        constexpr uint32_t DIM_SUBPASS_DATA = 6;
+        // OpTypeImage "sampled" operand of images used with load and store
+        constexpr uint32_t IMAGE_STORAGE = 2;
+
+        struct SpirvType {
+            uint32_t opcode = 0;
+            // operands following the result id
+            std::vector<uint32_t> operands;
+        };
+
+        struct SpirvVariable {
+            uint32_t id;
+            uint32_t pointerType;
+            uint32_t storageClass;
+        };
+
+        struct SpirvModule {
+            VkShaderStageFlags stage = 0;
+            std::unordered_map<uint32_t, SpirvType> types;
+            std::unordered_map<uint32_t, uint32_t> constants;
+            std::unordered_map<uint32_t, std::map<uint32_t, uint32_t>> decorations;
+            // by struct id, then member index
+            std::unordered_map<uint32_t, std::map<uint32_t, std::map<uint32_t, uint32_t>>> memberDecorations;
+            std::vector<SpirvVariable> variables;
+
+            const SpirvType &Type(uint32_t id) const {
+                static const SpirvType unknown{};
+                auto it = types.find(id);
+                return it != types.end() ? it->second : unknown;
+            }
+
+            bool HasDecoration(uint32_t id, uint32_t decoration) const {
+                auto it = decorations.find(id);
+                return it != decorations.end() && it->second.contains(decoration);
+            }
+
+            uint32_t Decoration(uint32_t id, uint32_t decoration, uint32_t fallback) const {
+                auto it = decorations.find(id);
+                if (it == decorations.end() || !it->second.contains(decoration)) {
+                    return fallback;
+                }
+                return it->second.at(decoration);
+            }
+
+            uint32_t MemberDecoration(uint32_t id, uint32_t member, uint32_t decoration) const {
+                auto it = memberDecorations.find(id);
+                if (it == memberDecorations.end() || !it->second.contains(member) ||
+                    !it->second.at(member).contains(decoration)) {
+                    return 0;
+                }
+                return it->second.at(member).at(decoration);
+            }
+
+            uint32_t ArrayLength(const SpirvType &array) const {
+                auto it = constants.find(array.operands[1]);
+                return it != constants.end() ? it->second : 1;
+            }
+        };
+
+        VkShaderStageFlags StageFromExecutionModel(uint32_t executionModel) {
+            switch (executionModel) {
+            case 0:
+                return VK_SHADER_STAGE_VERTEX_BIT;
+            case 1:
+                return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+            case 2:
+                return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+            case 3:
+                return VK_SHADER_STAGE_GEOMETRY_BIT;
+            case 4:
+                return VK_SHADER_STAGE_FRAGMENT_BIT;
+            case 5:
+                return VK_SHADER_STAGE_COMPUTE_BIT;
+            default:
+                return 0;
+            }
+        }
+
+        // Size of a type in a push constant block. Matrix columns are matrixStride apart, which is decorated on the
+        // struct member holding the matrix rather than on the matrix type.
+        uint32_t TypeSize(const SpirvModule &module, uint32_t typeId, uint32_t matrixStride) {
+            const SpirvType &type = module.Type(typeId);
+            switch (type.opcode) {
+            case OP_TYPE_BOOL:
+                return 4;
+            case OP_TYPE_INT:
+            case OP_TYPE_FLOAT:
+                return type.operands[0] / 8;
+            case OP_TYPE_VECTOR:
+                return type.operands[1] * TypeSize(module, type.operands[0], 0);
+            case OP_TYPE_MATRIX:
+                return type.operands[1] * (matrixStride != 0 ? matrixStride : TypeSize(module, type.operands[0], 0));
+            case OP_TYPE_ARRAY: {
+                uint32_t stride = module.Decoration(typeId, DECORATION_ARRAY_STRIDE,
+                                                    TypeSize(module, type.operands[0], matrixStride));
+                return module.ArrayLength(type) * stride;
+            }
+            case OP_TYPE_STRUCT: {
+                uint32_t size = 0;
+                for (uint32_t member = 0; member < type.operands.size(); member++) {
+                    uint32_t offset = module.MemberDecoration(typeId, member, DECORATION_OFFSET);
+                    uint32_t stride = module.MemberDecoration(typeId, member, DECORATION_MATRIX_STRIDE);
+                    size = std::max(size, offset + TypeSize(module, type.operands[member], stride));
+                }
+                return size;
+            }
+            default:
+                return 0;
+            }
+        }
+
+        bool ReflectDescriptor(const SpirvModule &module, uint32_t typeId, uint32_t storageClass,
+                               ReflectedBinding &binding) {
+            // arrays of descriptors, the binding holds one descriptor per element
+            const SpirvType *type = &module.Type(typeId);
+            while (type->opcode == OP_TYPE_ARRAY || type->opcode == OP_TYPE_RUNTIME_ARRAY) {
+                if (type->opcode == OP_TYPE_RUNTIME_ARRAY) {
+                    return false;
+                }
+                binding.count *= module.ArrayLength(*type);
+                typeId = type->operands[0];
+                type = &module.Type(typeId);
+            }
+
+            if (storageClass == STORAGE_CLASS_STORAGE_BUFFER) {
+                binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                return true;
+            }
+            if (storageClass == STORAGE_CLASS_UNIFORM) {
+                // older compilers declare storage buffers as uniform blocks decorated with BufferBlock
+                bool storage = module.HasDecoration(typeId, DECORATION_BUFFER_BLOCK);
+                binding.type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                return true;
+            }
+
+            switch (type->opcode) {
+            case OP_TYPE_SAMPLED_IMAGE:
+                binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                return true;
+            case OP_TYPE_SAMPLER:
+                binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+                return true;
+            case OP_TYPE_IMAGE: {
+                uint32_t dim = type->operands[1];
+                bool storage = type->operands[5] == IMAGE_STORAGE;
+                if (dim == DIM_BUFFER) {
+                    binding.type =
+                        storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                } else if (dim == DIM_SUBPASS_DATA) {
+                    binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                } else {
+                    binding.type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                }
+                return true;
+            }
+            default:
+                return false;
+            }
+        }
+    } // namespace
+
+    void ShaderLayout::Merge(const ShaderLayout &other) {
+        for (auto &[set, bindings] : other.sets) {
+            for (auto &[index, binding] : bindings) {
+                auto [it, inserted] = sets[set].try_emplace(index, binding);
+                if (!inserted) {
+                    it->second.stages |= binding.stages;
+                }
+            }
+        }
+        pushConstantSize = std::max(pushConstantSize, other.pushConstantSize);
+        pushConstantStages |= other.pushConstantStages;
+    }
+
+    bool ReflectShader(const std::vector<uint32_t> &code, ShaderLayout &layout) {
+        layout = {};
+        if (code.size() < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) {
+            IC_CORE_ERROR("Shader code is not SPIR-V.");
+            return false;
+        }
+
+        SpirvModule module;
+        for (size_t offset = SPIRV_HEADER_WORDS; offset < code.size();) {
+            const uint32_t *words = code.data() + offset;
+            uint32_t opcode = words[0] & 0xFFFF;
+            uint32_t wordCount = words[0] >> 16;
+            if (wordCount == 0 || offset + wordCount > code.size()) {
+                IC_CORE_ERROR("Shader code is truncated.");
+                return false;
+            }
+            offset += wordCount;
+
+            // decorations without a literal, such as Block, are stored with a value of 0
+            if (opcode == OP_ENTRY_POINT && wordCount >= 2) {
+                module.stage |= StageFromExecutionModel(words[1]);
+            } else if (opcode == OP_DECORATE && wordCount >= 3) {
+                module.decorations[words[1]][words[2]] = wordCount >= 4 ? words[3] : 0;
+            } else if (opcode == OP_MEMBER_DECORATE && wordCount >= 4) {
+                module.memberDecorations[words[1]][words[2]][words[3]] = wordCount >= 5 ? words[4] : 0;
+            } else if ((opcode == OP_CONSTANT || opcode == OP_SPEC_CONSTANT) && wordCount >= 4) {
+                module.constants[words[2]] = words[3];
+            } else if (opcode == OP_VARIABLE && wordCount >= 4) {
+                module.variables.push_back({words[2], words[1], words[3]});
+            } else if (opcode >= OP_TYPE_BOOL && opcode <= OP_TYPE_POINTER && wordCount >= 2) {
+                module.types[words[1]] = {opcode, std::vector<uint32_t>(words + 2, words + wordCount)};
+            }
+        }
+
+        for (const SpirvVariable &variable : module.variables) {
+            const SpirvType &pointer = module.Type(variable.pointerType);
+            if (pointer.opcode != OP_TYPE_POINTER || pointer.operands.size() < 2) {
+                continue;
+            }
+            uint32_t typeId = pointer.operands[1];
+
+            if (variable.storageClass == STORAGE_CLASS_PUSH_CONSTANT) {
+                layout.pushConstantSize = std::max(layout.pushConstantSize, TypeSize(module, typeId, 0));
+                layout.pushConstantStages |= module.stage;
+                continue;
+            }
+
+            // everything else, such as stage inputs and outputs, is not bound through descriptors
+            if ((variable.storageClass != STORAGE_CLASS_UNIFORM_CONSTANT &&
+                 variable.storageClass != STORAGE_CLASS_UNIFORM &&
+                 variable.storageClass != STORAGE_CLASS_STORAGE_BUFFER) ||
+                !module.HasDecoration(variable.id, DECORATION_BINDING)) {
+                continue;
+            }
+
+            uint32_t set = module.Decoration(variable.id, DECORATION_DESCRIPTOR_SET, 0);
+            uint32_t index = module.Decoration(variable.id, DECORATION_BINDING, 0);
+            ReflectedBinding binding{};
+            if (!ReflectDescriptor(module, typeId, variable.storageClass, binding)) {
+                IC_CORE_ERROR("Shader declares an unsupported resource at set {0}, binding {1}.", set, index);
+                return false;
+            }
+            binding.stages = module.stage;
+            layout.sets[set][index] = binding;
+        }
+
+        return true;
+    }
+} // namespace IC
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <compare>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace IC {
+    struct ReflectedBinding {
+        VkDescriptorType type;
+        uint32_t count = 1;
+        VkShaderStageFlags stages = 0;
+
+        auto operator<=>(const ReflectedBinding &other) const = default;
+    };
+
+    // bindings of one descriptor set by binding index
+    using DescriptorSetBindings = std::map<uint32_t, ReflectedBinding>;
+
+    // Resources a shader declares, read from its SPIR-V. Unused declarations are usually stripped by the compiler.
+    struct ShaderLayout {
+        std::map<uint32_t, DescriptorSetBindings> sets;
+        uint32_t pushConstantSize = 0;
+        VkShaderStageFlags pushConstantStages = 0;
+
+        // Adds the resources of another stage. Resources declared by both stages are visible to both.
+        void Merge(const ShaderLayout &other);
+    };
+
+    // Returns false if the code is not SPIR-V or declares resources the renderer can't bind, such as runtime sized
+    // descriptor arrays.
+    bool ReflectShader(const std::vector<uint32_t> &code, ShaderLayout &layout);
+} // namespace IC
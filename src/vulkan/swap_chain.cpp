@@ -295,7 +295,9 @@ namespace IC {
             size.depth = 1;
             size.width = swapChainExtent.width;
             size.height = swapChainExtent.height;
-            _allocator.CreateImage(size, _swapChainDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            // sampled when building the depth pyramid
+            _allocator.CreateImage(size, _swapChainDepthFormat,
+                                   VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                                    _depthImages[i]);
         }
     }
@@ -379,7 +381,7 @@ namespace IC {
     VkFormat SwapChain::FindDepthFormat() {
         return _device.FindSupportedFormat(
             {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT}, VK_IMAGE_TILING_OPTIMAL,
-            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
     }
 
 } // namespace IC
@@ -3,6 +3,8 @@
 
 #include "vulkan_initializers.h"
 
+#include <algorithm>
+
 namespace IC {
     VulkanAllocator::VulkanAllocator(VulkanDevice &device) : _device{device} {
         VmaAllocatorCreateInfo allocatorCreateInfo = AllocatorCreateInfo(_device);
@@ -14,7 +16,7 @@ namespace IC {
     }
 
     void VulkanAllocator::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
-                                       AllocatedBuffer &buffer) {
+                                       AllocatedBuffer &buffer, VmaAllocationCreateFlags flags) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
@@ -23,7 +25,7 @@ namespace IC {
 
         VmaAllocationCreateInfo vmaAllocInfo{};
         vmaAllocInfo.usage = memoryUsage;
-        vmaAllocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        vmaAllocInfo.flags = flags | VMA_ALLOCATION_CREATE_MAPPED_BIT;
 
         VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaAllocInfo, &buffer.buffer, &buffer.allocation,
                                  &buffer.allocInfo));
@@ -35,10 +37,10 @@ namespace IC {
         memcpy(buffer.allocInfo.pMappedData, data, size);
     }
 
-    void VulkanAllocator::CreateImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
-                                      AllocatedImage &image) {
+    void VulkanAllocator::CreateImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, AllocatedImage &image,
+                                      uint32_t mipLevels, uint32_t arrayLayers) {
         VkImageCreateInfo imageCreateInfo =
-            ImageCreateInfo(size.width, size.height, format, VK_IMAGE_TILING_OPTIMAL, usage);
+            ImageCreateInfo(size.width, size.height, format, VK_IMAGE_TILING_OPTIMAL, usage, mipLevels, arrayLayers);
 
         VmaAllocationCreateInfo allocInfo = {};
         allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
@@ -47,7 +49,9 @@ namespace IC {
         VK_CHECK(vmaCreateImage(_allocator, &imageCreateInfo, &allocInfo, &image.image, &image.allocation, nullptr));
 
         VkImageAspectFlags aspectFlag = VK_IMAGE_ASPECT_COLOR_BIT;
-        if (format == VK_FORMAT_D32_SFLOAT) {
+        // views of depth stencil images only see depth, so they can be sampled
+        if (format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+            format == VK_FORMAT_D24_UNORM_S8_UINT) {
             aspectFlag = VK_IMAGE_ASPECT_DEPTH_BIT;
         }
 
@@ -57,6 +61,10 @@ namespace IC {
         VK_CHECK(vkCreateImageView(_device.Device(), &viewInfo, nullptr, &image.view));
     }
 
+    void VulkanAllocator::InvalidateBuffer(AllocatedBuffer &buffer) {
+        VK_CHECK(vmaInvalidateAllocation(_allocator, buffer.allocation, 0, VK_WHOLE_SIZE));
+    }
+
     void VulkanAllocator::DestroyBuffer(AllocatedBuffer &buffer) {
         vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation);
 
@@ -71,4 +79,21 @@ namespace IC {
         image.image = nullptr;
         image.view = nullptr;
     }
+
+    bool GrowableBuffer::Reserve(VulkanAllocator &allocator, uint32_t count) {
+        if (count <= capacity) {
+            return false;
+        }
+
+        Destroy(allocator);
+        capacity = std::max({count, capacity * 2, MIN_CAPACITY});
+        allocator.CreateBuffer(Size(), usage, memoryUsage, buffer);
+        return true;
+    }
+
+    void GrowableBuffer::Destroy(VulkanAllocator &allocator) {
+        if (capacity > 0) {
+            allocator.DestroyBuffer(buffer);
+        }
+    }
 } // namespace IC
\ No newline at end of file
@@ -11,12 +11,18 @@ namespace IC {
         VulkanAllocator(VulkanDevice &device);
         ~VulkanAllocator();
 
+        // Buffers are persistently mapped. The default flags suit buffers only written on the cpu, buffers read
+        // back need VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT.
         void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
-                          AllocatedBuffer &buffer);
+                          AllocatedBuffer &buffer,
+                          VmaAllocationCreateFlags flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
         void CreateBuffer(void *data, VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,
                           AllocatedBuffer &buffer);
-        void CreateImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, AllocatedImage &image);
+        void CreateImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, AllocatedImage &image,
+                         uint32_t mipLevels = 1, uint32_t arrayLayers = 1);
 
+        // Makes gpu writes visible to the cpu, needed before reading memory that may not be host coherent
+        void InvalidateBuffer(AllocatedBuffer &buffer);
         void DestroyBuffer(AllocatedBuffer &buffer);
         void DestroyImage(AllocatedImage &image);
 
@@ -27,4 +33,23 @@ namespace IC {
         VmaAllocator _allocator;
         VulkanDevice &_device;
     };
+
+    // Mapped buffer of elementSize sized elements, whose capacity at least doubles when it runs out. The old buffer
+    // is destroyed right away, so it may only grow while no commands using it are in flight, as is the case for a
+    // frame's own buffers once the frame's previous commands have finished.
+    struct GrowableBuffer {
+        static constexpr uint32_t MIN_CAPACITY = 256;
+
+        VkDeviceSize elementSize;
+        VkBufferUsageFlags usage;
+        VmaMemoryUsage memoryUsage;
+        AllocatedBuffer buffer{};
+        uint32_t capacity = 0;
+
+        // Makes room for count elements. Returns true if the buffer was replaced, in which case descriptor sets
+        // referring to it have to be rewritten.
+        bool Reserve(VulkanAllocator &allocator, uint32_t count);
+        void Destroy(VulkanAllocator &allocator);
+        VkDeviceSize Size() { return capacity * elementSize; }
+    };
 } // namespace IC
\ No newline at end of file
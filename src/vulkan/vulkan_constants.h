@@ -4,5 +4,20 @@
 
 namespace IC {
     const uint32_t VULKAN_API_VERSION = VK_API_VERSION_1_3;
-    const int MAX_POINT_LIGHTS = 4;
+    // material bindings that can sample a layer of a packed texture array
+    const int MAX_MATERIAL_TEXTURES = 8;
+
+    // hard coded camera until the scene camera drives rendering
+    const float CAMERA_FOV = 45.0f;
+    const float CAMERA_NEAR = 0.1f;
+    const float CAMERA_FAR = 10.0f;
+
+    // light clusters along x and y on screen and along z in view space, depth slices grow exponentially from
+    // CAMERA_NEAR to CAMERA_FAR
+    const uint32_t LIGHT_CLUSTERS_X = 16;
+    const uint32_t LIGHT_CLUSTERS_Y = 9;
+    const uint32_t LIGHT_CLUSTERS_Z = 24;
+
+    // objects covering a smaller radius on screen, in pixels, are skipped by gpu culling
+    const float MIN_OBJECT_PIXEL_RADIUS = 0.5f;
 } // namespace IC
\ No newline at end of file
@@ -146,13 +146,31 @@ namespace IC {
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        VkPhysicalDeviceVulkan12Features supportedVulkan12Features{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        VkPhysicalDeviceFeatures2 supportedFeatures2{.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+        supportedFeatures2.pNext = &supportedVulkan12Features;
+        vkGetPhysicalDeviceFeatures2(_physicalDevice, &supportedFeatures2);
+        VkPhysicalDeviceFeatures &supportedFeatures = supportedFeatures2.features;
+
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        // optional, compressed textures are rejected at load time when unavailable
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+        // optional, without them objects are culled and drawn from the cpu
+        drawIndirectCount = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance &&
+                            supportedVulkan12Features.drawIndirectCount;
+        deviceFeatures.multiDrawIndirect = drawIndirectCount;
+        deviceFeatures.drawIndirectFirstInstance = drawIndirectCount;
+        VkPhysicalDeviceVulkan12Features vulkan12Features{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        vulkan12Features.drawIndirectCount = drawIndirectCount;
 
         VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeature{
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES};
         dynamicRenderingFeature.dynamicRendering = VK_TRUE;
-        dynamicRenderingFeature.pNext = nullptr;
+        dynamicRenderingFeature.pNext = &vulkan12Features;
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -175,6 +193,7 @@ namespace IC {
         }
 
         VK_CHECK(vkCreateDevice(_physicalDevice, &createInfo, nullptr, &_device));
+        features = deviceFeatures;
 
         vkGetDeviceQueue(_device, indices.graphicsFamily, 0, &_graphicsQueue);
         vkGetDeviceQueue(_device, indices.presentFamily, 0, &_presentQueue);
@@ -79,6 +79,10 @@ namespace IC {
         void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
         VkPhysicalDeviceProperties properties;
+        // features enabled on the logical device
+        VkPhysicalDeviceFeatures features;
+        // multi draw indirect with a gpu written draw count, used for gpu driven rendering when available
+        bool drawIndirectCount = false;
 
     private:
         void CreateInstance();
@@ -7,6 +7,7 @@
 #include "swap_chain.h"
 #include "vulkan_util.h"
 
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 
 #include <iostream>
@@ -58,15 +59,16 @@ namespace IC {
     }
 
     VkImageCreateInfo ImageCreateInfo(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-                                      VkImageUsageFlags usage) {
+                                      VkImageUsageFlags usage, uint32_t mipLevels /*= 1*/,
+                                      uint32_t arrayLayers /*= 1*/) {
         VkImageCreateInfo info{};
         info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         info.imageType = VK_IMAGE_TYPE_2D;
         info.extent.width = static_cast<uint32_t>(width);
         info.extent.height = static_cast<uint32_t>(height);
         info.extent.depth = 1;
-        info.mipLevels = 1;
-        info.arrayLayers = 1;
+        info.mipLevels = mipLevels;
+        info.arrayLayers = arrayLayers;
         info.format = format;
         info.tiling = tiling;
         info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -93,6 +95,26 @@ namespace IC {
         return info;
     }
 
+    VkImageMemoryBarrier ImageMemoryBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                            VkAccessFlags srcAccess, VkAccessFlags dstAccess, uint32_t mipLevels) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+        return barrier;
+    }
+
     VkRenderingInfo RenderingInfo(VkExtent2D renderExtent, VkRenderingAttachmentInfo *colorAttachment,
                                   VkRenderingAttachmentInfo *depthAttachment) {
         VkRenderingInfo info{.sType = VK_STRUCTURE_TYPE_RENDERING_INFO};
@@ -128,11 +150,9 @@ namespace IC {
         renderData.mvpBuffers.resize(maxFrames);
 
         for (size_t i = 0; i < maxFrames; i++) {
-            // hard coded for now
             CameraDescriptors projection{};
-            projection.proj = glm::perspective(
-                glm::radians(45.0f),
-                (float)swapChain.GetSwapChainExtent().width / swapChain.GetSwapChainExtent().height, 0.1f, 10.0f);
+            projection.proj = CameraProjectionMatrix(swapChain.GetSwapChainExtent());
+            projection.view = CameraViewMatrix();
 
             allocator.CreateBuffer(sizeof(CameraDescriptors), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO,
                                    renderData.mvpBuffers[i]);
@@ -144,21 +164,10 @@ namespace IC {
         }
     }
 
-    void WriteLightDescriptors(VulkanAllocator &allocator, size_t maxFrames, DescriptorWriter &writer,
-                               std::vector<AllocatedBuffer> &lightBuffers) {
-        lightBuffers.resize(maxFrames);
-        for (size_t i = 0; i < maxFrames; i++) {
-            allocator.CreateBuffer(sizeof(SceneLightDescriptors), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                   VMA_MEMORY_USAGE_AUTO, lightBuffers[i]);
-
-            writer.WriteBuffer(0, lightBuffers[i].buffer, sizeof(SceneLightDescriptors), 0,
-                               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-        }
-    }
-
     void WriteMaterialDescriptors(VulkanAllocator &allocator, size_t maxFrames, DescriptorWriter &writer,
                                   MaterialInstance &material, VulkanTextureManager &textureManager,
-                                  std::vector<AllocatedBuffer> &materialBuffers) {
+                                  std::vector<AllocatedBuffer> &materialBuffers,
+                                  std::map<int, TextureHandle> &textures) {
         // create material buffer
         materialBuffers.resize(maxFrames);
         VkDeviceSize size = 0;
@@ -169,6 +178,8 @@ namespace IC {
             // uniform binding types only
             if (binding.binding->bindingType == BindingType::Uniform) {
                 size += static_cast<VkDeviceSize>(binding.size);
+            } else {
+                textures[index] = textureManager.AcquireTexture(*static_cast<std::string *>(binding.value));
             }
         }
 
@@ -177,7 +188,7 @@ namespace IC {
 
             for (auto &[index, binding] : material.BindingValues()) {
                 if (binding.binding->bindingType == BindingType::Texture) {
-                    AllocatedImage *texture = textureManager.GetTexture(*static_cast<std::string *>(binding.value));
+                    AllocatedImage *texture = textureManager.GetImage(textures[index]);
                     writer.WriteImage(index, texture->view, textureManager.DefaultSampler(),
                                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                                       VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
@@ -190,7 +201,7 @@ namespace IC {
     }
 
     SceneLightDescriptors CreateSceneLightDescriptors(SceneLightData &lightData, glm::mat4 viewMat) {
-        SceneLightDescriptors descriptors;
+        SceneLightDescriptors descriptors{};
         glm::quat rotation = glm::quat(glm::vec3(glm::radians(lightData.directionalLight->direction.x),
                                                  glm::radians(lightData.directionalLight->direction.y),
                                                  glm::radians(lightData.directionalLight->direction.z)));
@@ -203,12 +214,18 @@ namespace IC {
         directionalDescriptors.amb = lightData.directionalLight->ambient;
         directionalDescriptors.spec = lightData.directionalLight->specular;
         descriptors.directionalLight = directionalDescriptors;
+        return descriptors;
+    }
 
-        for (int i = 0; i < lightData.pointLights.size() && i < MAX_POINT_LIGHTS; i++) {
-            glm::vec3 lightViewSpacePos = viewMat * glm::vec4(lightData.pointLights[i].transform->position, 1.0f);
+    void CreatePointLightDescriptors(SceneLightData &lightData, glm::mat4 viewMat,
+                                     std::vector<PointLightDescriptors> &descriptors) {
+        descriptors.resize(lightData.pointLights.size());
+        for (size_t i = 0; i < lightData.pointLights.size(); i++) {
+            glm::vec3 lightViewSpacePos = viewMat * glm::vec4(lightData.pointLights[i].transform->Position(), 1.0f);
 
             PointLightDescriptors pointLightDescriptors{};
             pointLightDescriptors.pos = lightViewSpacePos;
+            pointLightDescriptors.range = lightData.pointLights[i].light->Range();
             pointLightDescriptors.amb = lightData.pointLights[i].light->ambient;
             pointLightDescriptors.diff = lightData.pointLights[i].light->color;
             pointLightDescriptors.spec = lightData.pointLights[i].light->specular;
@@ -216,13 +233,20 @@ namespace IC {
             pointLightDescriptors.lin = lightData.pointLights[i].light->Linear();
             pointLightDescriptors.quad = lightData.pointLights[i].light->Quadratic();
 
-            descriptors.pointLights[i] = pointLightDescriptors;
+            descriptors[i] = pointLightDescriptors;
         }
-        descriptors.numPointLights = std::min(static_cast<int>(lightData.pointLights.size()), MAX_POINT_LIGHTS);
-        return descriptors;
     }
 
     // images
+    glm::vec3 CameraPosition() { return glm::vec3(2.0f, 2.0f, 2.0f); }
+
+    glm::mat4 CameraViewMatrix() { return glm::lookAt(CameraPosition(), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f)); }
+
+    glm::mat4 CameraProjectionMatrix(VkExtent2D extent) {
+        return glm::perspective(glm::radians(CAMERA_FOV), (float)extent.width / extent.height, CAMERA_NEAR,
+                                CAMERA_FAR);
+    }
+
     void CreateImageSampler(VkDevice device, float maxAnisotropy, VkSampler &textureSampler) {
         VkSamplerCreateInfo samplerInfo{};
         samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -240,7 +264,7 @@ namespace IC {
         samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         samplerInfo.mipLodBias = 0.0f;
         samplerInfo.minLod = 0.0f;
-        samplerInfo.maxLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
         if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
             IC_CORE_ERROR("Failed to create texture sampler.");
@@ -248,75 +272,54 @@ namespace IC {
     }
 
     // pipelines
-    std::shared_ptr<Pipeline> CreateOpaquePipeline(VkDevice device, SwapChain &swapChain,
-                                                   MaterialInstance &materialData) {
-        std::vector<VkDescriptorSetLayout> descriptorSets;
-        // per object descriptors
-        DescriptorLayoutBuilder descriptorLayoutBuilder{};
-        descriptorLayoutBuilder.AddBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER); // Camera Descriptors
-        descriptorSets.push_back(descriptorLayoutBuilder.Build(device, VK_SHADER_STAGE_VERTEX_BIT));
-        descriptorLayoutBuilder.Clear();
-
-        // lit descriptors
-        if (materialData.Template().flags & MaterialFlags::Lit) {
-            descriptorLayoutBuilder.AddBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER); // scene light data
-            descriptorSets.push_back(descriptorLayoutBuilder.Build(device, VK_SHADER_STAGE_FRAGMENT_BIT));
-            descriptorLayoutBuilder.Clear();
-        }
+    // Compiles a pipeline object against an existing layout. Only reads its arguments, so it can run on worker
+    // threads. Also used to rebuild pipelines when their shaders are reloaded.
+    VkPipeline BuildOpaquePipeline(VkDevice device, const PipelineKey &key, VkPipelineLayout layout,
+                                   VkShaderModule vertShader, VkShaderModule fragShader,
+                                   VkPipelineCache pipelineCache) {
+        PipelineBuilder pipelineBuilder;
+        pipelineBuilder.pipelineCache = pipelineCache;
 
-        // material descriptors
-        for (auto &[index, value] : materialData.BindingValues()) {
-            descriptorLayoutBuilder.AddBinding(index, value.binding->bindingType == BindingType::Texture
-                                                          ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
-                                                          : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-        }
-        if (materialData.BindingValues().size() > 0) {
-            descriptorSets.push_back(
-                descriptorLayoutBuilder.Build(device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT));
+        pipelineBuilder.pipelineLayout = layout;
+        pipelineBuilder.SetShaders(vertShader, fragShader);
+        pipelineBuilder.SetSpecializationConstants(key.specializationConstants);
+        pipelineBuilder.SetInputTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        pipelineBuilder.SetPolygonMode(VK_POLYGON_MODE_FILL);
+        pipelineBuilder.SetCullMode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_CLOCKWISE);
+        pipelineBuilder.SetMultisamplingNone();
+        key.materialFlags &MaterialFlags::Transparent ? pipelineBuilder.EnableBlending()
+                                                       : pipelineBuilder.DisableBlending();
+        // transparent objects don't hide what is behind them, from later draws or from occlusion culling
+        if (key.depthPrepass) {
+            pipelineBuilder.EnableDepthTest(false, VK_COMPARE_OP_EQUAL);
+        } else {
+            pipelineBuilder.EnableDepthTest(!(key.materialFlags & MaterialFlags::Transparent));
         }
+        pipelineBuilder.SetColorAttachmentFormat(key.colorFormat);
+        pipelineBuilder.SetDepthFormat(key.depthFormat);
 
-        // pipeline layout
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = descriptorSets.size();
-        pipelineLayoutInfo.pSetLayouts = descriptorSets.data();
-
-        // push constants
-        VkPushConstantRange pushConstants =
-            PushConstants<TransformationPushConstants>(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-        pipelineLayoutInfo.pushConstantRangeCount = 1;
-        pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
-
-        VkPipelineLayout pipelineLayout;
-        VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+        return pipelineBuilder.BuildPipeline(device);
+    }
 
+    // Pipeline writing depth and nothing else, for the depth prepass of a pipeline with the same key and vertex
+    // shader
+    VkPipeline BuildDepthOnlyPipeline(VkDevice device, const PipelineKey &key, VkPipelineLayout layout,
+                                      VkShaderModule vertShader, VkPipelineCache pipelineCache) {
         PipelineBuilder pipelineBuilder;
+        pipelineBuilder.pipelineCache = pipelineCache;
 
-        pipelineBuilder.pipelineLayout = pipelineLayout;
-        VkShaderModule vertShaderModule =
-            PipelineBuilder::CreateShaderModule(device, materialData.Template().vertShaderData);
-        VkShaderModule fragShaderModule =
-            PipelineBuilder::CreateShaderModule(device, materialData.Template().fragShaderData);
-
-        pipelineBuilder.SetShaders(vertShaderModule, fragShaderModule);
+        pipelineBuilder.pipelineLayout = layout;
+        pipelineBuilder.SetVertexShader(vertShader);
+        pipelineBuilder.SetSpecializationConstants(key.specializationConstants);
         pipelineBuilder.SetInputTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
         pipelineBuilder.SetPolygonMode(VK_POLYGON_MODE_FILL);
         pipelineBuilder.SetCullMode(VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_CLOCKWISE);
         pipelineBuilder.SetMultisamplingNone();
-        materialData.Template().flags &MaterialFlags::Transparent ? pipelineBuilder.EnableBlending()
-                                                                  : pipelineBuilder.DisableBlending();
+        pipelineBuilder.DisableBlending();
         pipelineBuilder.EnableDepthTest();
-        pipelineBuilder.SetColorAttachmentFormat(swapChain.GetSwapChainImageFormat());
-        pipelineBuilder.SetDepthFormat(swapChain.GetSwapChainDepthFormat());
-
-        std::shared_ptr<Pipeline> pipeline = std::make_shared<Pipeline>();
-        pipeline->pipeline = pipelineBuilder.BuildPipeline(device);
-        pipeline->layout = pipelineLayout;
-        pipeline->descriptorSetLayouts = descriptorSets;
-        pipeline->shaderModules = {vertShaderModule, fragShaderModule};
-        pipeline->materialFlags = materialData.Template().flags;
+        pipelineBuilder.SetDepthFormat(key.depthFormat);
 
-        return pipeline;
+        return pipelineBuilder.BuildPipeline(device);
     }
 
     // ImGui
@@ -3,6 +3,7 @@
 #include <ic_gameobject.h>
 
 #include "descriptors.h"
+#include "pipelines.h"
 #include "swap_chain.h"
 #include "vulkan_device.h"
 #include "vulkan_texture_manager.h"
@@ -21,8 +22,10 @@ namespace IC {
     VkCommandBufferBeginInfo CommandBufferBeginInfo(VkCommandBufferUsageFlags flags = 0);
     VkCommandBufferSubmitInfo CommandBufferSubmitInfo(VkCommandBuffer cmd);
     VkImageCreateInfo ImageCreateInfo(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-                                      VkImageUsageFlags usage);
+                                      VkImageUsageFlags usage, uint32_t mipLevels = 1, uint32_t arrayLayers = 1);
     VkImageViewCreateInfo ImageViewCreateInfo(VkFormat format, VkImage image, VkImageAspectFlags aspect);
+    VkImageMemoryBarrier ImageMemoryBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                            VkAccessFlags srcAccess, VkAccessFlags dstAccess, uint32_t mipLevels = 1);
     VkRenderingInfo RenderingInfo(VkExtent2D renderExtent, VkRenderingAttachmentInfo *colorAttachment,
                                   VkRenderingAttachmentInfo *depthAttachment);
     VkSubmitInfo2 SubmitInfo(VkCommandBufferSubmitInfo *cmd, VkSemaphoreSubmitInfo *signalSemaphoreInfo,
@@ -39,19 +42,28 @@ namespace IC {
     // descriptors
     void WritePerObjectDescriptors(VulkanAllocator &allocator, SwapChain &swapChain, DescriptorWriter &writer,
                                    MeshRenderData &renderData);
-    void WriteLightDescriptors(VulkanAllocator &allocator, size_t maxFrames, DescriptorWriter &writer,
-                               std::vector<AllocatedBuffer> &lightBuffers);
     void WriteMaterialDescriptors(VulkanAllocator &allocator, size_t maxFrames, DescriptorWriter &writer,
                                   MaterialInstance &material, VulkanTextureManager &textureManager,
-                                  std::vector<AllocatedBuffer> &materialBuffers);
+                                  std::vector<AllocatedBuffer> &materialBuffers,
+                                  std::map<int, TextureHandle> &textures);
     SceneLightDescriptors CreateSceneLightDescriptors(SceneLightData &lightData, glm::mat4 viewMat);
+    void CreatePointLightDescriptors(SceneLightData &lightData, glm::mat4 viewMat,
+                                     std::vector<PointLightDescriptors> &descriptors);
+
+    // camera
+    glm::vec3 CameraPosition();
+    glm::mat4 CameraViewMatrix();
+    glm::mat4 CameraProjectionMatrix(VkExtent2D extent);
 
     // images
     void CreateImageSampler(VkDevice device, float maxAnisotropy, VkSampler &textureSampler);
 
     // pipelines
-    std::shared_ptr<Pipeline> CreateOpaquePipeline(VkDevice device, SwapChain &swapChain,
-                                                   MaterialInstance &materialData);
+    VkPipeline BuildOpaquePipeline(VkDevice device, const PipelineKey &key, VkPipelineLayout layout,
+                                   VkShaderModule vertShader, VkShaderModule fragShader,
+                                   VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+    VkPipeline BuildDepthOnlyPipeline(VkDevice device, const PipelineKey &key, VkPipelineLayout layout,
+                                      VkShaderModule vertShader, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
 
     // ImGui
     void InitImGui(VulkanDevice &device, GLFWwindow *window, VkDescriptorPool descriptorPool, VkFormat imageFormat);
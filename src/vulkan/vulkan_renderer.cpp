@@ -2,30 +2,77 @@
 
 #include <ic_log.h>
 
+#include "render_queue.h"
+#include "shader_compiler.h"
 #include "vulkan_util.h"
 
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/quaternion.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <string>
 
 namespace IC {
+    namespace {
+        // Materials of one template sampling the same texture files, in whatever layers, are drawn with the first
+        // one's material set, as long as their uniform values match too
+        std::string MaterialStateKey(MaterialInstance &material) {
+            std::string key = std::to_string(reinterpret_cast<uintptr_t>(&material.Template()));
+            for (auto &[index, binding] : material.BindingValues()) {
+                if (binding.binding->bindingType == BindingType::Texture) {
+                    key += '\n' + std::to_string(index) + ':' +
+                           TextureFilePath(*static_cast<std::string *>(binding.value));
+                }
+            }
+            return key;
+        }
+
+        // uniform values may change every frame, so they are compared while batching instead of being keyed
+        bool SameUniformValues(MaterialInstance &a, MaterialInstance &b) {
+            if (&a == &b) {
+                return true;
+            }
+            return std::equal(a.BindingValues().begin(), a.BindingValues().end(), b.BindingValues().begin(),
+                              b.BindingValues().end(), [](const auto &first, const auto &second) {
+                                  const ShaderBindingValue &x = first.second;
+                                  const ShaderBindingValue &y = second.second;
+                                  return first.first == second.first &&
+                                         (x.binding->bindingType != BindingType::Uniform ||
+                                          (x.size == y.size && std::memcmp(x.value, y.value, x.size) == 0));
+                              });
+        }
+    } // namespace
+
     VulkanRenderer::VulkanRenderer(const RendererConfig &config)
         : Renderer(config),
           _vulkanDevice(config.window),
           _allocator{_vulkanDevice},
-          _textureManager{_vulkanDevice, _allocator},
-          _windowExtent{static_cast<uint32_t>(config.width), static_cast<uint32_t>(config.height)} {
+          _textureManager{_vulkanDevice, _allocator, _fileWatcher},
+          _gpuScene{_vulkanDevice, _allocator},
+          _lightClusters{_allocator},
+          _windowExtent{static_cast<uint32_t>(config.width), static_cast<uint32_t>(config.height)},
+          _depthPrepass{config.depthPrepass},
+          _occlusionCulling{config.occlusionCulling} {
         // find rendering functions
         VulkanBeginRendering =
             (PFN_vkCmdBeginRenderingKHR)vkGetInstanceProcAddr(_vulkanDevice.Instance(), "vkCmdBeginRenderingKHR");
         VulkanEndRendering =
             (PFN_vkCmdEndRenderingKHR)vkGetInstanceProcAddr(_vulkanDevice.Instance(), "vkCmdEndRenderingKHR");
 
+        // only the gpu culling pass can test against the pyramid
+        if (_gpuScene.IsGpuDriven()) {
+            _depthPyramid.emplace(_vulkanDevice, _allocator);
+        }
         RecreateSwapChain();
 
+        _pipelineManager.CreatePipelineCache(_vulkanDevice);
+        _pipelineManager.CreateFallbackPipeline(_vulkanDevice.Device(), *_swapChain);
         CreateCommandBuffers();
         InitDescriptorAllocators();
+        CreatePlaceholderMesh();
         InitImGui(_vulkanDevice, window, _imGuiDescriptorAllocator.GetDescriptorPool(),
                   _swapChain->GetSwapChainImageFormat());
 
@@ -41,17 +88,19 @@ namespace IC {
         ImGui_ImplVulkan_Shutdown();
         _meshDescriptorAllocator.DestroyDescriptorPool(_vulkanDevice.Device());
         _imGuiDescriptorAllocator.DestroyDescriptorPool(_vulkanDevice.Device());
+        _pipelineManager.SavePipelineCache(_vulkanDevice);
         _pipelineManager.DestroyPipelines(_vulkanDevice.Device());
+        _allocator.DestroyBuffer(_placeholderVertexBuffer);
+        _allocator.DestroyBuffer(_placeholderIndexBuffer);
 
-        for (auto mesh : _renderData) {
-            _allocator.DestroyBuffer(mesh.vertexBuffer);
-            _allocator.DestroyBuffer(mesh.indexBuffer);
+        for (auto &mesh : _renderData) {
+            mesh.gpuMesh = nullptr;
 
             for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
                 _allocator.DestroyBuffer(mesh.mvpBuffers[i]);
-                _allocator.DestroyBuffer(mesh.materialBuffers[i]);
             }
-            for (auto buffer : mesh.lightsBuffers) {
+            // only created once the object's pipeline has its layouts
+            for (AllocatedBuffer &buffer : mesh.materialBuffers) {
                 _allocator.DestroyBuffer(buffer);
             }
         }
@@ -78,6 +127,14 @@ namespace IC {
     void VulkanRenderer::DrawFrame() {
         double start = glfwGetTime();
 
+        // hot reload changed assets, the previous frame has finished so resources can be swapped safely
+        _fileWatcher.Poll();
+        std::vector<std::string> reloadedTextures = _textureManager.Update();
+        if (!reloadedTextures.empty()) {
+            RefreshMaterialTextures(reloadedTextures);
+        }
+        _pipelineManager.Update(_vulkanDevice.Device());
+
         ImGui_ImplVulkan_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -87,12 +144,19 @@ namespace IC {
         ImGui::Render();
 
         renderStats.drawCalls = 0;
+        renderStats.instances = 0;
+        renderStats.pipelineBinds = 0;
+        renderStats.geometryBinds = 0;
         renderStats.numTris = 0;
+        renderStats.culledObjects = 0;
+        renderStats.culledTris = 0;
+        renderStats.occludedObjects = 0;
+        renderStats.occludedTris = 0;
         renderStats.frametime = 0.0f;
+        renderStats.textureMemory = _textureManager.ResidentMemory();
 
-        // update scene light descriptors
-        SceneLightDescriptors sceneLightDescriptors = CreateSceneLightDescriptors(
-            _lightData, glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+        glm::mat4 view = CameraViewMatrix();
+        CameraDescriptors camera{CameraProjectionMatrix(_swapChain->GetSwapChainExtent()), view};
 
         uint32_t imageIndex;
         auto result = _swapChain->AcquireNextImage(&imageIndex);
@@ -161,56 +225,104 @@ namespace IC {
         TransitionImageLayout(_cBuffers[imageIndex], _swapChain->GetImage(imageIndex),
                               _swapChain->GetSwapChainImageFormat(), VK_IMAGE_LAYOUT_UNDEFINED,
                               VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        // depth is cleared, so its previous contents can be dropped
+        VkImageMemoryBarrier depthBarrier = ImageMemoryBarrier(
+            _swapChain->GetDepthImage(imageIndex).image, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, 0,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+        depthBarrier.subresourceRange.aspectMask = DepthAspectFlags(_swapChain->GetSwapChainDepthFormat());
+        vkCmdPipelineBarrier(_cBuffers[imageIndex], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &depthBarrier);
 
-        VulkanBeginRendering(_cBuffers[imageIndex], &renderingInfo);
         for (MeshRenderData &data : _renderData) {
-            // rebuild vertex and index buffers if required
-            if (data.meshData.MeshUpdated()) {
-                _allocator.DestroyBuffer(data.vertexBuffer);
-                _allocator.DestroyBuffer(data.indexBuffer);
-
-                data.vertexBuffer = {};
-                data.indexBuffer = {};
-
-                _allocator.CreateBuffer(data.meshData.Vertices().data(),
-                                        sizeof(data.meshData.Vertices()[0]) * data.meshData.VertexCount(),
-                                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO, data.vertexBuffer);
-                _allocator.CreateBuffer(data.meshData.Indices().data(),
-                                        sizeof(data.meshData.Indices()[0]) * data.meshData.IndexCount(),
-                                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO, data.indexBuffer);
-
-                data.meshData.ClearMeshUpdatedFlag();
+            // pick up finished loads and switch to the matching gpu mesh if required
+            data.meshData.PollLoad();
+            UpdateGpuMesh(data);
+            WriteMaterialDescriptorSets(data);
+        }
+        Frustum frustum = Frustum::FromMatrix(camera.proj * camera.view);
+        CullRenderData(frustum);
+        bool cpuOcclusion = _occlusionCulling && !_gpuScene.IsGpuDriven();
+        bool gpuOcclusion = _occlusionCulling && _gpuScene.IsGpuDriven();
+        if (cpuOcclusion) {
+            RasterizeOccluders(camera.proj * camera.view);
+        }
+
+        // sort the frame's draws by state, so binds can be skipped when consecutive draws share them
+        _renderQueue.Clear();
+        for (uint32_t i = 0; i < _renderData.size(); i++) {
+            MeshRenderData &data = _renderData[i];
+            if (!_visibility[i]) {
+                renderStats.culledObjects++;
+                renderStats.culledTris += (data.IsResident() ? data.gpuMesh->indexCount : _placeholderIndexCount) / 3;
+                continue;
+            }
+            if (cpuOcclusion &&
+                _occlusionBuffer.IsOccluded(TransformBounds(data.meshData.LocalBounds(), _modelMatrices[i]))) {
+                renderStats.occludedObjects++;
+                renderStats.occludedTris += (data.IsResident() ? data.gpuMesh->indexCount : _placeholderIndexCount) / 3;
+                continue;
             }
 
-            // bind pipeline todo: only bind if different
-            vkCmdBindPipeline(_cBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, data.renderPipeline->pipeline);
-
-            // build model matrix
-            glm::quat rotation =
-                glm::quat(glm::vec3(glm::radians(data.transform.rotation.x), glm::radians(data.transform.rotation.y),
-                                    glm::radians(data.transform.rotation.z)));
-            TransformationPushConstants pushConstants{};
-            pushConstants.model = glm::translate(glm::mat4(1.0f), data.transform.position) * glm::toMat4(rotation) *
-                                  glm::scale(glm::mat4(1.0f), data.transform.scale);
-            pushConstants.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-
-            vkCmdPushConstants(_cBuffers[imageIndex], data.renderPipeline->layout,
-                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                               sizeof(TransformationPushConstants), &pushConstants);
-
-            if (data.meshData.Material()->Template().flags & MaterialFlags::Lit) {
-                // update light data
-                data.UpdateUniformBuffer<SceneLightDescriptors>(sceneLightDescriptors,
-                                                                data.lightsBuffers[_swapChain->GetCurrentFrame()]);
+            RenderPass pass = data.meshData.Material()->Template().flags & MaterialFlags::Transparent
+                                  ? RenderPass::Transparent
+                                  : RenderPass::Opaque;
+            float depth = -(view * glm::vec4(data.transform.Position(), 1.0f)).z / CAMERA_FAR;
+            _renderQueue.Push(RenderQueue::MakeKey(pass, DrawPipeline(data).id, data.materialId,
+                                                   data.IsResident() ? data.gpuMesh->id : 0, depth),
+                              i);
+        }
+        _renderQueue.Sort();
+
+        size_t frame = _swapChain->GetCurrentFrame();
+        BuildDrawBatches(frame);
+
+        // assign the point lights to clusters, all lit objects share the result
+        SceneLightDescriptors sceneLightDescriptors = CreateSceneLightDescriptors(_lightData, view);
+        CreatePointLightDescriptors(_lightData, view, _pointLightDescriptors);
+        if (_lightClusters.Update(frame, sceneLightDescriptors, _pointLightDescriptors,
+                                  _swapChain->GetSwapChainExtent())) {
+            for (MeshRenderData &data : _renderData) {
+                WriteLightDescriptors(data, frame);
             }
+        }
 
-            data.Bind(_cBuffers[imageIndex], data.renderPipeline->layout, _swapChain->GetCurrentFrame());
-            data.Draw(_cBuffers[imageIndex]);
-            renderStats.drawCalls++;
-            renderStats.numTris += data.meshData.IndexCount() / 3;
+        uint32_t batchCount = static_cast<uint32_t>(_drawBatches.size());
+        if (_gpuScene.IsGpuDriven()) {
+            CullingData cullingData{};
+            cullingData.view = view;
+            std::copy(std::begin(frustum.planes), std::end(frustum.planes), cullingData.planes);
+            cullingData.projection = {camera.proj[0][0], camera.proj[1][1], camera.proj[2][2], camera.proj[3][2]};
+            cullingData.cameraPosition = CameraPosition();
+            cullingData.objectCount = static_cast<uint32_t>(_renderQueue.Commands().size());
+            cullingData.pixelScale =
+                _swapChain->GetSwapChainExtent().height / (2.0f * std::tan(glm::radians(CAMERA_FOV) * 0.5f));
+            cullingData.minPixelRadius = MIN_OBJECT_PIXEL_RADIUS;
+            cullingData.nearPlane = CAMERA_NEAR;
+            cullingData.firstTransparentBatch = _firstTransparentBatch;
+            _gpuScene.SetCullingData(frame, cullingData);
+
+            // the culling pass writes the draw commands, so it has to run before rendering starts
+            _gpuScene.RecordCulling(_cBuffers[imageIndex], frame,
+                                    gpuOcclusion ? CullingPass::Early : CullingPass::All, batchCount);
         }
 
-        VulkanEndRendering(_cBuffers[imageIndex]);
+        // lay down the depth of expensive opaque objects first, so the main pass shades each of their pixels once
+        bool depthPrepass = std::any_of(_drawBatches.begin(), _drawBatches.end(), [this](const DrawBatch &batch) {
+            return DepthPrepassed(_renderData[batch.renderIndex]);
+        });
+        // transparent objects are left to the late pass, so they blend over all opaque objects, back to front
+        DrawScene(_cBuffers[imageIndex], frame, camera, renderingInfo, depthPrepass, !gpuOcclusion);
+
+        if (gpuOcclusion) {
+            // opaque objects that came into view since the last frame, then the transparent ones
+            _depthPyramid->Build(_cBuffers[imageIndex], *_swapChain, imageIndex);
+            _gpuScene.RecordCulling(_cBuffers[imageIndex], frame, CullingPass::Late, batchCount);
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+            DrawScene(_cBuffers[imageIndex], frame, camera, renderingInfo, depthPrepass, true);
+        }
 
         RenderImGui(_cBuffers[imageIndex], _swapChain->GetImageView(imageIndex));
 
@@ -237,6 +349,14 @@ namespace IC {
 
         vkDeviceWaitIdle(_vulkanDevice.Device());
 
+        if (gpuOcclusion) {
+            const CullingStats &cullingStats = _gpuScene.Stats(frame);
+            renderStats.occludedObjects = cullingStats.occludedObjects;
+            renderStats.occludedTris = cullingStats.occludedTris;
+            renderStats.instances -= cullingStats.occludedObjects;
+            renderStats.numTris -= cullingStats.occludedTris;
+        }
+
         double end = glfwGetTime();
         double elapsed = end - start;
         renderStats.frametime = elapsed * 1000.0f;
@@ -254,6 +374,7 @@ namespace IC {
         std::vector<VkDescriptorPoolSize> poolSizes{};
         poolSizes.push_back({VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000});
         poolSizes.push_back({VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000});
+        poolSizes.push_back({VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000});
 
         _meshDescriptorAllocator.CreateDescriptorPool(_vulkanDevice.Device(), poolSizes, 1000);
 
@@ -278,49 +399,417 @@ namespace IC {
     // Adds a mesh and associated material to list of renderable objects
     void VulkanRenderer::AddMesh(Mesh &mesh, Transform &transform) {
         MeshRenderData meshRenderData{.meshData = mesh, .transform = transform};
+        // lit opaque materials are the expensive ones to shade more than once per pixel
+        MaterialFlags flags = mesh.Material()->Template().flags;
+        meshRenderData.depthPrepass = _depthPrepass && (flags & MaterialFlags::Lit) &&
+                                      !(flags & MaterialFlags::Transparent);
+        meshRenderData.materialId =
+            _materialIds.try_emplace(MaterialStateKey(*mesh.Material()), static_cast<uint32_t>(_materialIds.size()))
+                .first->second;
+        for (auto &[index, binding] : mesh.Material()->BindingValues()) {
+            if (binding.binding->bindingType == BindingType::Texture && index < MAX_MATERIAL_TEXTURES) {
+                meshRenderData.textureLayers[index] = TextureLayer(*static_cast<std::string *>(binding.value));
+            }
+        }
 
-        meshRenderData.renderPipeline =
-            _pipelineManager.FindOrCreateSuitablePipeline(_vulkanDevice.Device(), *_swapChain.get(), *mesh.Material());
-
-        // vertex buffers
-        _allocator.CreateBuffer(mesh.Vertices().data(), sizeof(mesh.Vertices()[0]) * mesh.VertexCount(),
-                                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO, meshRenderData.vertexBuffer);
-        _allocator.CreateBuffer(mesh.Indices().data(), sizeof(mesh.Indices()[0]) * mesh.IndexCount(),
-                                VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO, meshRenderData.indexBuffer);
-        mesh.ClearMeshUpdatedFlag();
+        meshRenderData.renderPipeline = _pipelineManager.FindOrCreateSuitablePipeline(
+            _vulkanDevice.Device(), *_swapChain.get(), *mesh.Material(), meshRenderData.depthPrepass);
+        WatchPipelineShaders(*meshRenderData.renderPipeline);
 
-        // write descriptor sets
-        _meshDescriptorAllocator.AllocateDescriptorSets(
-            _vulkanDevice.Device(), meshRenderData.renderPipeline->descriptorSetLayouts, meshRenderData.descriptorSets);
+        // vertex buffers, if the mesh has already finished loading
+        mesh.PollLoad();
+        UpdateGpuMesh(meshRenderData);
 
-        // per object descriptors (set 0)
+        // per object descriptors (set 0), which is all the fallback pipeline binds
+        _meshDescriptorAllocator.AllocateDescriptorSets(_vulkanDevice.Device(),
+                                                        _pipelineManager.FallbackPipeline().descriptorSetLayouts,
+                                                        meshRenderData.descriptorSets);
         DescriptorWriter writer{};
         WritePerObjectDescriptors(_allocator, *_swapChain.get(), writer, meshRenderData);
         for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
             writer.UpdateSet(_vulkanDevice.Device(), meshRenderData.descriptorSets[i][0]);
+            WriteObjectBufferDescriptor(meshRenderData, i);
+        }
+
+        // right away if the pipeline already exists, otherwise once its shaders have been reflected
+        WriteMaterialDescriptorSets(meshRenderData);
+        _renderData.push_back(meshRenderData);
+    }
+
+    // Allocates and writes the sets past the per object one as soon as the object's pipeline has its layouts. They
+    // are written before the pipeline is ready, as it is only built after its layouts.
+    void VulkanRenderer::WriteMaterialDescriptorSets(MeshRenderData &data) {
+        std::vector<VkDescriptorSetLayout> &layouts = data.renderPipeline->descriptorSetLayouts;
+        size_t allocated = data.descriptorSets[0].size();
+        if (allocated >= layouts.size()) {
+            return;
+        }
+
+        std::vector<VkDescriptorSetLayout> missingLayouts(layouts.begin() + allocated, layouts.end());
+        std::vector<std::vector<VkDescriptorSet>> missingSets;
+        _meshDescriptorAllocator.AllocateDescriptorSets(_vulkanDevice.Device(), missingLayouts, missingSets);
+        for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            data.descriptorSets[i].insert(data.descriptorSets[i].end(), missingSets[i].begin(), missingSets[i].end());
         }
-        writer.Clear();
 
         // scene data/lighting descriptors (set 1)
-        if (mesh.Material()->Template().flags & MaterialFlags::Lit) {
-            WriteLightDescriptors(_allocator, SwapChain::MAX_FRAMES_IN_FLIGHT, writer, meshRenderData.lightsBuffers);
+        for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            WriteLightDescriptors(data, i);
+        }
+
+        // material descriptors (set 1 or 2), materials without bindings have no set
+        DescriptorWriter writer{};
+        WriteMaterialDescriptors(_allocator, SwapChain::MAX_FRAMES_IN_FLIGHT, writer, *data.meshData.Material(),
+                                 _textureManager, data.materialBuffers, data.textures);
+        uint32_t materialSet = data.MaterialSetIndex();
+        for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+            if (materialSet < data.descriptorSets[i].size()) {
+                writer.UpdateSet(_vulkanDevice.Device(), data.descriptorSets[i][materialSet]);
+            }
+            data.UpdateMaterialBuffer(i);
+        }
+    }
+
+    // Walks the scene hierarchy to find visible objects. Subtrees fully inside the frustum are accepted as a whole,
+    // objects crossing a plane get a finer sphere and box test in one SIMD batch. When culling runs on the gpu, they
+    // are left to the culling pass instead.
+    void VulkanRenderer::CullRenderData(const Frustum &frustum) {
+        UpdateSceneBounds();
+
+        _visibility.assign(_renderData.size(), 0);
+        _modelMatrices.resize(_renderData.size());
+        _insideObjects.clear();
+        _intersectingObjects.clear();
+        sceneBvh.QueryFrustum(frustum, _insideObjects, _intersectingObjects);
+
+        for (uint32_t index : _insideObjects) {
+            uint32_t renderIndex = sceneObjects[index].renderIndex;
+            if (renderIndex != NO_RENDER_INDEX) {
+                _visibility[renderIndex] = 1;
+                _modelMatrices[renderIndex] = _renderData[renderIndex].transform.ModelMatrix();
+            }
+        }
+
+        _cullingBatch.Clear();
+        _batchRenderIndices.clear();
+        for (uint32_t index : _intersectingObjects) {
+            uint32_t renderIndex = sceneObjects[index].renderIndex;
+            if (renderIndex == NO_RENDER_INDEX) {
+                continue;
+            }
+            MeshRenderData &data = _renderData[renderIndex];
+            _modelMatrices[renderIndex] = data.transform.ModelMatrix();
+            if (_gpuScene.IsGpuDriven()) {
+                _visibility[renderIndex] = 1;
+                continue;
+            }
+            _cullingBatch.Add(TransformBounds(data.meshData.LocalBounds(), _modelMatrices[renderIndex]),
+                              TransformBounds(data.meshData.LocalSphere(), _modelMatrices[renderIndex]));
+            _batchRenderIndices.push_back(renderIndex);
+        }
+        _cullingBatch.Cull(frustum, _batchVisibility);
+        for (size_t i = 0; i < _batchRenderIndices.size(); i++) {
+            _visibility[_batchRenderIndices[i]] = _batchVisibility[i];
+        }
+    }
+
+    // Rasterizes the visible occluders for the cpu occlusion test. Occluders outside the frustum can't hide anything
+    // inside it.
+    void VulkanRenderer::RasterizeOccluders(const glm::mat4 &viewProjection) {
+        _occlusionBuffer.Begin(viewProjection);
+        for (uint32_t i = 0; i < _renderData.size(); i++) {
+            Mesh &mesh = _renderData[i].meshData;
+            if (_visibility[i] && mesh.IsOccluder() && mesh.Asset() != nullptr && mesh.Asset()->IsLoaded()) {
+                _occlusionBuffer.AddOccluder(*mesh.Asset(), _modelMatrices[i]);
+            }
+        }
+        _occlusionBuffer.Rasterize();
+    }
+
+    // Records the depth prepass, if any batch takes part in it, and the main pass. Transparent batches, which come
+    // after all opaque ones, are only drawn if asked for.
+    void VulkanRenderer::DrawScene(VkCommandBuffer cBuffer, size_t frame, const CameraDescriptors &camera,
+                                   VkRenderingInfo renderingInfo, bool depthPrepass, bool transparent) {
+        uint32_t batchCount = transparent ? static_cast<uint32_t>(_drawBatches.size()) : _firstTransparentBatch;
+        VkRenderingAttachmentInfo depthAttachment = *renderingInfo.pDepthAttachment;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+        if (depthPrepass) {
+            VkRenderingInfo prepassInfo = renderingInfo;
+            prepassInfo.colorAttachmentCount = 0;
+            prepassInfo.pColorAttachments = nullptr;
+            VulkanBeginRendering(cBuffer, &prepassInfo);
+            DrawBatches(cBuffer, frame, camera, true, batchCount);
+            VulkanEndRendering(cBuffer);
+
+            VkMemoryBarrier depthBarrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+            depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            depthBarrier.dstAccessMask =
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            vkCmdPipelineBarrier(cBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                 0, 1, &depthBarrier, 0, nullptr, 0, nullptr);
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        }
+
+        VulkanBeginRendering(cBuffer, &renderingInfo);
+        DrawBatches(cBuffer, frame, camera, false, batchCount);
+        VulkanEndRendering(cBuffer);
+    }
+
+    // Records the draw batches. The depth prepass only draws the batches it covers, with the depth only variant of
+    // their pipeline.
+    void VulkanRenderer::DrawBatches(VkCommandBuffer cBuffer, size_t frame, const CameraDescriptors &camera,
+                                     bool depthPrepass, uint32_t batchCount) {
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+        for (uint32_t batchIndex = 0; batchIndex < batchCount; batchIndex++) {
+            const DrawBatch &batch = _drawBatches[batchIndex];
+            MeshRenderData &data = _renderData[batch.renderIndex];
+            if (depthPrepass && !DepthPrepassed(data)) {
+                continue;
+            }
+
+            Pipeline &pipeline = DrawPipeline(data);
+            VkPipeline handle = depthPrepass ? pipeline.depthPipeline : pipeline.pipeline;
+            if (handle != boundPipeline) {
+                vkCmdBindPipeline(cBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, handle);
+                boundPipeline = handle;
+                renderStats.pipelineBinds++;
+            }
+
+            // objects of a batch share their material, so the first object's descriptor sets serve all of them
+            data.UpdateMvpBuffer(camera, frame);
+            data.BindDescriptorSets(cBuffer, pipeline.layout, frame, pipeline.descriptorSetLayouts.size());
+
+            AllocatedBuffer &vertexBuffer = data.IsResident() ? data.gpuMesh->vertexBuffer : _placeholderVertexBuffer;
+            AllocatedBuffer &indexBuffer = data.IsResident() ? data.gpuMesh->indexBuffer : _placeholderIndexBuffer;
+            if (vertexBuffer.buffer != boundVertexBuffer) {
+                data.BindGeometry(cBuffer, vertexBuffer, indexBuffer);
+                boundVertexBuffer = vertexBuffer.buffer;
+                renderStats.geometryBinds++;
+            }
+
+            renderStats.drawCalls++;
+            if (_gpuScene.IsGpuDriven()) {
+                _gpuScene.DrawIndirect(cBuffer, frame, batchIndex, batch.firstObject, batch.objectCount);
+            } else if (data.IsResident()) {
+                // the whole batch is one instanced draw
+                data.Draw(cBuffer, batch.firstObject, batch.objectCount);
+            } else {
+                vkCmdDrawIndexed(cBuffer, _placeholderIndexCount, batch.objectCount, 0, 0, batch.firstObject);
+            }
+        }
+    }
+
+    // Objects take part in the depth prepass once their own pipeline, which tests for the prepass depth, is ready.
+    // The fallback pipeline tests with less, so it can't draw over prepass depth.
+    bool VulkanRenderer::DepthPrepassed(MeshRenderData &data) {
+        return data.depthPrepass && data.renderPipeline->IsReady();
+    }
+
+    // Fills the frame's object buffer in queue order and groups consecutive draws that share all state into batches
+    void VulkanRenderer::BuildDrawBatches(size_t frame) {
+        const std::vector<RenderCommand> &commands = _renderQueue.Commands();
+
+        _drawBatches.clear();
+        for (uint32_t i = 0; i < commands.size(); i++) {
+            MeshRenderData &data = _renderData[commands[i].object];
+            if (!_drawBatches.empty() && !(data.meshData.Material()->Template().flags & MaterialFlags::Transparent)) {
+                MeshRenderData &first = _renderData[_drawBatches.back().renderIndex];
+                if (&DrawPipeline(first) == &DrawPipeline(data) && first.materialId == data.materialId &&
+                    first.gpuMesh == data.gpuMesh &&
+                    SameUniformValues(*first.meshData.Material(), *data.meshData.Material())) {
+                    _drawBatches.back().objectCount++;
+                    continue;
+                }
+            }
+            _drawBatches.push_back({i, 1, commands[i].object});
+        }
+        auto firstTransparent = std::find_if(_drawBatches.begin(), _drawBatches.end(), [this](const DrawBatch &batch) {
+            return _renderData[batch.renderIndex].meshData.Material()->Template().flags & MaterialFlags::Transparent;
+        });
+        _firstTransparentBatch = static_cast<uint32_t>(firstTransparent - _drawBatches.begin());
+
+        if (_gpuScene.Reserve(frame, static_cast<uint32_t>(commands.size()), static_cast<uint32_t>(_drawBatches.size()),
+                              static_cast<uint32_t>(_renderData.size()))) {
+            for (MeshRenderData &data : _renderData) {
+                WriteObjectBufferDescriptor(data, frame);
+            }
+        }
+
+        GpuObjectData *objects = _gpuScene.Objects(frame);
+        for (uint32_t batchIndex = 0; batchIndex < _drawBatches.size(); batchIndex++) {
+            const DrawBatch &batch = _drawBatches[batchIndex];
+            for (uint32_t i = batch.firstObject; i < batch.firstObject + batch.objectCount; i++) {
+                uint32_t renderIndex = commands[i].object;
+                MeshRenderData &data = _renderData[renderIndex];
+                const glm::mat4 &model = _modelMatrices[renderIndex];
+
+                GpuObjectData &object = objects[i];
+                object.model = model;
+                object.normal = glm::mat4(glm::transpose(glm::inverse(glm::mat3(model))));
+                BoundingSphere sphere = TransformBounds(data.meshData.LocalSphere(), model);
+                object.sphere = glm::vec4(sphere.center, sphere.radius);
+                object.indexCount = data.IsResident() ? data.gpuMesh->indexCount : _placeholderIndexCount;
+                object.batch = batchIndex;
+                object.firstCommand = batch.firstObject;
+                object.renderIndex = renderIndex;
+                object.textureLayers = data.textureLayers;
+
+                // counts what was submitted, objects culled on the gpu are only subtracted if found occluded
+                renderStats.numTris += object.indexCount / 3;
+                renderStats.instances++;
+
+                RequestMaterialTextures(data);
+            }
+        }
+    }
+
+    // Points binding 2 of an object's set 0 at the frame's object buffer
+    void VulkanRenderer::WriteObjectBufferDescriptor(MeshRenderData &data, size_t frame) {
+        DescriptorWriter writer{};
+        writer.WriteBuffer(2, _gpuScene.ObjectBuffer(frame).buffer, _gpuScene.ObjectBufferSize(frame), 0,
+                           VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        writer.UpdateSet(_vulkanDevice.Device(), data.descriptorSets[frame][0]);
+    }
+
+    // Points set 1 of a lit object at the frame's light cluster buffers
+    void VulkanRenderer::WriteLightDescriptors(MeshRenderData &data, size_t frame) {
+        // sets that aren't allocated yet get the current buffers once they are
+        bool lit = data.meshData.Material()->Template().flags & MaterialFlags::Lit;
+        if (!lit || data.descriptorSets[frame].size() < 2) {
+            return;
+        }
+
+        DescriptorWriter writer{};
+        _lightClusters.WriteDescriptors(writer, frame);
+        writer.UpdateSet(_vulkanDevice.Device(), data.descriptorSets[frame][1]);
+    }
+
+    // objects whose pipeline is still compiling are drawn with the fallback pipeline
+    Pipeline &VulkanRenderer::DrawPipeline(MeshRenderData &data) {
+        return data.renderPipeline->IsReady() ? *data.renderPipeline : _pipelineManager.FallbackPipeline();
+    }
+
+    // Points a render object at the shared gpu copy of its mesh asset
+    void VulkanRenderer::UpdateGpuMesh(MeshRenderData &data) {
+        std::shared_ptr<MeshAsset> &asset = data.meshData.Asset();
+        if (asset == nullptr || !asset->IsLoaded() || asset->IndexCount() == 0) {
+            data.gpuMesh = nullptr;
+            return;
+        }
+
+        if (data.gpuMesh != nullptr && data.gpuMesh->asset == asset && data.gpuMesh->version == asset->Version()) {
+            return;
+        }
+        data.gpuMesh = AcquireGpuMesh(asset);
+    }
+
+    // Returns the gpu mesh for an asset, uploading it when no render object holds a current copy yet.
+    // Buffers are freed when the last render object releases the gpu mesh.
+    std::shared_ptr<GpuMesh> VulkanRenderer::AcquireGpuMesh(std::shared_ptr<MeshAsset> &asset) {
+        auto it = _gpuMeshes.find(asset.get());
+        std::shared_ptr<GpuMesh> gpuMesh = it != _gpuMeshes.end() ? it->second.lock() : nullptr;
+
+        if (gpuMesh == nullptr) {
+            gpuMesh = std::shared_ptr<GpuMesh>(new GpuMesh{}, [this](GpuMesh *mesh) {
+                _gpuMeshes.erase(mesh->asset.get());
+                _fileWatcher.Unwatch(mesh->asset->Path());
+                _allocator.DestroyBuffer(mesh->vertexBuffer);
+                _allocator.DestroyBuffer(mesh->indexBuffer);
+                delete mesh;
+            });
+            gpuMesh->asset = asset;
+            gpuMesh->id = _nextGpuMeshId++;
+            _gpuMeshes[asset.get()] = gpuMesh;
+
+            // the asset is kept alive by the gpu mesh for as long as the watch exists
+            MeshAsset *watchedAsset = asset.get();
+            _fileWatcher.Watch(asset->Path(), [watchedAsset](const std::string &) { watchedAsset->Reload(); });
+        }
+
+        if (gpuMesh->version != asset->Version()) {
+            // cpu data was released by the residency policy, stream it back in and upload once it arrives
+            if (!asset->HasCpuData()) {
+                asset->RequestCpuData();
+                return gpuMesh->version > 0 ? gpuMesh : nullptr;
+            }
+
+            MeshData &meshData = *asset->Data();
+
+            _allocator.DestroyBuffer(gpuMesh->vertexBuffer);
+            _allocator.DestroyBuffer(gpuMesh->indexBuffer);
+
+            _allocator.CreateBuffer(meshData.vertices.data(), sizeof(VertexData) * meshData.vertices.size(),
+                                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO, gpuMesh->vertexBuffer);
+            _allocator.CreateBuffer(meshData.indices.data(), sizeof(uint32_t) * meshData.indices.size(),
+                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO, gpuMesh->indexBuffer);
+            gpuMesh->indexCount = static_cast<uint32_t>(meshData.indices.size());
+            gpuMesh->version = asset->Version();
+
+            asset->ApplyResidency();
+        }
+
+        return gpuMesh;
+    }
+
+    void VulkanRenderer::CreatePlaceholderMesh() {
+        std::shared_ptr<MeshData> placeholder = CreatePlaceholderMeshData();
+        _placeholderIndexCount = static_cast<uint32_t>(placeholder->indices.size());
+
+        _allocator.CreateBuffer(placeholder->vertices.data(), sizeof(VertexData) * placeholder->vertices.size(),
+                                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO, _placeholderVertexBuffer);
+        _allocator.CreateBuffer(placeholder->indices.data(), sizeof(uint32_t) * placeholder->indices.size(),
+                                VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_AUTO, _placeholderIndexBuffer);
+    }
+
+    void VulkanRenderer::WatchPipelineShaders(Pipeline &pipeline) {
+        // the callback gets the watched file, which is the compiled .spv when shaders aren't compiled at runtime
+        for (const std::string &shaderPath : {pipeline.vertShaderPath, pipeline.fragShaderPath}) {
+            _fileWatcher.Watch(ShaderFilePath(shaderPath), [this, shaderPath](const std::string &) {
+                _pipelineManager.ReloadShader(_vulkanDevice.Device(), shaderPath);
+            });
+        }
+    }
 
+    // Rewrites the material descriptors of every render object that samples one of the given textures
+    void VulkanRenderer::RefreshMaterialTextures(const std::vector<std::string> &texturePaths) {
+        for (MeshRenderData &data : _renderData) {
+            DescriptorWriter writer{};
+            for (auto &[index, texture] : data.textures) {
+                if (std::find(texturePaths.begin(), texturePaths.end(), texture->path) == texturePaths.end()) {
+                    continue;
+                }
+
+                AllocatedImage *image = _textureManager.GetImage(texture);
+                writer.WriteImage(index, image->view, _textureManager.DefaultSampler(),
+                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+            }
+
+            if (writer.writes.empty()) {
+                continue;
+            }
             for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
-                writer.UpdateSet(_vulkanDevice.Device(), meshRenderData.descriptorSets[i][1]);
+                writer.UpdateSet(_vulkanDevice.Device(), data.descriptorSets[i][data.MaterialSetIndex()]);
             }
-            writer.Clear();
         }
+    }
 
-        // material descriptors (set 1 or 2)
-        WriteMaterialDescriptors(_allocator, SwapChain::MAX_FRAMES_IN_FLIGHT, writer, *mesh.Material(), _textureManager,
-                                 meshRenderData.materialBuffers);
-        for (size_t i = 0; i < SwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
-            int index = mesh.Material()->Template().flags & MaterialFlags::Lit ? 2 : 1;
-            writer.UpdateSet(_vulkanDevice.Device(), meshRenderData.descriptorSets[i][index]);
-            meshRenderData.UpdateMaterialBuffer(i);
+    // Reports the object's rough on screen size for each of its textures, so their mips can be streamed in
+    void VulkanRenderer::RequestMaterialTextures(MeshRenderData &data) {
+        std::shared_ptr<MeshAsset> &asset = data.meshData.Asset();
+        float radius = (asset != nullptr && asset->IsLoaded()) ? asset->BoundingRadius() : 1.0f;
+        radius *= std::max({data.transform.Scale().x, data.transform.Scale().y, data.transform.Scale().z});
+
+        float distance = glm::length(data.transform.Position() - CameraPosition());
+        float screenSize = static_cast<float>(_swapChain->GetSwapChainExtent().height);
+        if (distance > radius) {
+            screenSize *= radius / (distance * std::tan(glm::radians(CAMERA_FOV) * 0.5f));
         }
 
-        _renderData.push_back(meshRenderData);
+        for (auto &[index, texture] : data.textures) {
+            _textureManager.RequestResolution(texture, screenSize);
+        }
     }
 
     void VulkanRenderer::AddDirectionalLight(std::shared_ptr<DirectionalLight> &light) {
@@ -328,12 +817,13 @@ namespace IC {
     }
 
     void VulkanRenderer::AddPointLight(std::shared_ptr<PointLight> &light, std::shared_ptr<Transform> &transform) {
-        if (_lightData.pointLights.size() < MAX_POINT_LIGHTS) {
-            _lightData.pointLights.push_back({light, transform});
-        }
+        _lightData.pointLights.push_back({light, transform});
     }
 
     void VulkanRenderer::AddGameObject(std::shared_ptr<GameObject> object) {
+        uint32_t renderIndex =
+            object->HasComponent<Mesh>() ? static_cast<uint32_t>(_renderData.size()) : NO_RENDER_INDEX;
+        AddSceneObject(object, renderIndex);
         if (object->HasComponent<Mesh>()) {
             AddMesh(*object->GetComponent<Mesh>(), *object->GetTransform());
         }
@@ -362,6 +852,12 @@ namespace IC {
                 CreateCommandBuffers();
             }
         }
+
+        // the culling pass always binds the pyramid, even when occlusion culling is off
+        if (_depthPyramid) {
+            _depthPyramid->Resize(*_swapChain);
+            _gpuScene.SetDepthPyramid(_depthPyramid->View(), _depthPyramid->Sampler());
+        }
     }
 
     void VulkanRenderer::RenderImGui(VkCommandBuffer cBuffer, VkImageView targetImageView) {
@@ -1,14 +1,23 @@
 #pragma once
 
+#include "ic_culling.h"
+#include "ic_file_watcher.h"
+#include "ic_occlusion.h"
 #include "ic_renderer.h"
 
+#include "depth_pyramid.h"
 #include "descriptors.h"
+#include "gpu_scene.h"
+#include "light_clusters.h"
 #include "pipelines.h"
+#include "render_queue.h"
 #include "swap_chain.h"
 #include "vulkan_initializers.h"
 #include "vulkan_texture_manager.h"
 #include "vulkan_types.h"
 
+#include <optional>
+
 namespace IC {
     class VulkanRenderer : public Renderer {
     public:
@@ -30,15 +39,42 @@ namespace IC {
         void AddDirectionalLight(std::shared_ptr<DirectionalLight> &light);
         void AddPointLight(std::shared_ptr<PointLight> &light, std::shared_ptr<Transform> &transform);
         void AddMesh(Mesh &mesh, Transform &transform);
+        Pipeline &DrawPipeline(MeshRenderData &data);
+        void CullRenderData(const Frustum &frustum);
+        void RasterizeOccluders(const glm::mat4 &viewProjection);
+        void BuildDrawBatches(size_t frame);
+        void DrawScene(VkCommandBuffer cBuffer, size_t frame, const CameraDescriptors &camera,
+                       VkRenderingInfo renderingInfo, bool depthPrepass, bool transparent);
+        void DrawBatches(VkCommandBuffer cBuffer, size_t frame, const CameraDescriptors &camera, bool depthPrepass,
+                         uint32_t batchCount);
+        bool DepthPrepassed(MeshRenderData &data);
+        void WriteObjectBufferDescriptor(MeshRenderData &data, size_t frame);
+        void WriteLightDescriptors(MeshRenderData &data, size_t frame);
+        void WriteMaterialDescriptorSets(MeshRenderData &data);
+        void UpdateGpuMesh(MeshRenderData &data);
+        std::shared_ptr<GpuMesh> AcquireGpuMesh(std::shared_ptr<MeshAsset> &asset);
+        void CreatePlaceholderMesh();
+
+        // hot reloading
+        void WatchPipelineShaders(Pipeline &pipeline);
+        void RefreshMaterialTextures(const std::vector<std::string> &texturePaths);
+
+        // texture streaming
+        void RequestMaterialTextures(MeshRenderData &data);
 
         // function pointers (for mac)
         PFN_vkCmdBeginRenderingKHR VulkanBeginRendering{};
         PFN_vkCmdEndRenderingKHR VulkanEndRendering{};
 
         // vulkan Helper Classes
+        FileWatcher _fileWatcher;
         VulkanDevice _vulkanDevice;
         VulkanAllocator _allocator;
         VulkanTextureManager _textureManager;
+        GpuScene _gpuScene;
+        // only created on gpu driven devices
+        std::optional<DepthPyramid> _depthPyramid;
+        LightClusters _lightClusters;
         std::unique_ptr<SwapChain> _swapChain;
         PipelineManager _pipelineManager{};
         DescriptorAllocator _meshDescriptorAllocator{};
@@ -46,16 +82,52 @@ namespace IC {
 
         // rendering data (mesh, lights)
         SceneLightData _lightData{};
+        std::vector<PointLightDescriptors> _pointLightDescriptors;
+        std::unordered_map<const MeshAsset *, std::weak_ptr<GpuMesh>> _gpuMeshes;
+        // 0 is the placeholder mesh
+        uint32_t _nextGpuMeshId = 1;
+        // by MaterialStateKey
+        std::unordered_map<std::string, uint32_t> _materialIds;
         std::vector<MeshRenderData> _renderData{};
+        RenderQueue _renderQueue;
+        // per object, indexed like _renderData
+        std::vector<uint8_t> _visibility;
+        std::vector<glm::mat4> _modelMatrices;
+        // culling scratch, kept to avoid allocating every frame
+        std::vector<uint32_t> _insideObjects;
+        std::vector<uint32_t> _intersectingObjects;
+        CullingBatch _cullingBatch;
+        std::vector<uint32_t> _batchRenderIndices;
+        std::vector<uint8_t> _batchVisibility;
+        OcclusionBuffer _occlusionBuffer;
+        // runs of the sorted queue sharing pipeline, material and mesh, whose objects are consecutive in the object
+        // buffer. Transparent objects are batches of their own to keep their order.
+        struct DrawBatch {
+            uint32_t firstObject;
+            uint32_t objectCount;
+            // render object whose descriptor sets the batch binds
+            uint32_t renderIndex;
+        };
+        std::vector<DrawBatch> _drawBatches;
+        // transparent batches follow the opaque ones, as the queue sorts by pass first
+        uint32_t _firstTransparentBatch = 0;
         std::vector<std::shared_ptr<GameObject>> _gameObjects;
         DirectionalLight _directionalLight;
         std::vector<std::shared_ptr<PointLight>> _pointLights;
 
+        // drawn in place of meshes that are still loading
+        AllocatedBuffer _placeholderVertexBuffer{};
+        AllocatedBuffer _placeholderIndexBuffer{};
+        uint32_t _placeholderIndexCount = 0;
+
         // command buffers
         std::vector<VkCommandBuffer> _cBuffers{};
 
         // window information
         VkExtent2D _windowExtent;
         bool _framebufferResized = false;
+
+        bool _depthPrepass;
+        bool _occlusionCulling;
     };
 } // namespace IC
@@ -1,77 +1,662 @@
 #include "vulkan_texture_manager.h"
 
+#include "ic_common.h"
+#include "ic_image.h"
+#include "ic_job_system.h"
+#include "ic_ktx2.h"
 #include "vulkan_initializers.h"
-#include "vulkan_util.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+
 namespace IC {
-    VulkanTextureManager::VulkanTextureManager(VulkanDevice &device, VulkanAllocator &allocator)
-        : _device{device}, _allocator{allocator} {
+    namespace {
+        const std::string TEXTURE_CACHE_DIRECTORY = "texture_cache";
+        // part of every cache key, change it whenever the way mip chains are generated changes
+        const std::string TEXTURE_CACHE_TAG = "rgba8-srgb;box";
+
+        // coarsest level that is still streamed, everything from here down stays resident
+        uint32_t FloorMip(const TextureData &textureData, uint32_t floorSize) {
+            uint32_t mip = 0;
+            while (mip + 1 < textureData.levels.size() &&
+                   std::max(textureData.levels[mip].width, textureData.levels[mip].height) > floorSize) {
+                mip++;
+            }
+            return mip;
+        }
+
+        // Entries are keyed by the source's path, size and modification time, so an edited file gets a new entry
+        // without hashing all of it. Empty if the source can't be inspected.
+        std::filesystem::path TextureCachePath(const std::string &texturePath) {
+            std::error_code error;
+            uintmax_t size = std::filesystem::file_size(texturePath, error);
+            if (error) {
+                return {};
+            }
+            std::filesystem::file_time_type modified = std::filesystem::last_write_time(texturePath, error);
+            if (error) {
+                return {};
+            }
+
+            std::string key = TEXTURE_CACHE_TAG + '\n' + texturePath + '\n' + std::to_string(size) + '\n' +
+                              std::to_string(modified.time_since_epoch().count());
+            char hash[17];
+            snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(HashText(key)));
+            std::filesystem::path cachePath = std::filesystem::path(TEXTURE_CACHE_DIRECTORY) / hash;
+            cachePath += ".ktx2";
+            return cachePath;
+        }
+
+        void WriteTextureCache(const std::filesystem::path &cachePath, const TextureData &textureData) {
+            Ktx2Texture ktx2{static_cast<uint32_t>(textureData.format), textureData.width, textureData.height,
+                             textureData.layers};
+            for (const TextureLevel &level : textureData.levels) {
+                auto begin = textureData.pixels.begin() + level.offset;
+                ktx2.levels.push_back({level.width, level.height, {begin, begin + level.size}});
+            }
+
+            // written next to the final file first, so a crash while writing can't leave a truncated entry behind
+            std::error_code error;
+            std::filesystem::create_directories(TEXTURE_CACHE_DIRECTORY, error);
+            std::filesystem::path temporaryPath = cachePath;
+            temporaryPath += ".tmp";
+            if (!WriteKtx2(temporaryPath.string(), ktx2)) {
+                IC_CORE_WARN("Failed to write texture cache entry {0}.", cachePath.string());
+                return;
+            }
+            std::filesystem::rename(temporaryPath, cachePath, error);
+            if (error) {
+                IC_CORE_WARN("Failed to write texture cache entry {0}.", cachePath.string());
+            }
+        }
+
+        // position of the '#' starting a trailing layer suffix, npos if the path has none
+        size_t LayerSeparator(const std::string &texturePath) {
+            size_t separator = texturePath.rfind('#');
+            if (separator == std::string::npos || separator == 0 || separator + 1 == texturePath.size() ||
+                !std::all_of(texturePath.begin() + separator + 1, texturePath.end(),
+                             [](unsigned char c) { return std::isdigit(c); })) {
+                return std::string::npos;
+            }
+            return separator;
+        }
+    } // namespace
+
+    std::string TextureFilePath(const std::string &texturePath) {
+        return texturePath.substr(0, LayerSeparator(texturePath));
+    }
+
+    uint32_t TextureLayer(const std::string &texturePath) {
+        size_t separator = LayerSeparator(texturePath);
+        if (separator == std::string::npos) {
+            return 0;
+        }
+        return static_cast<uint32_t>(std::strtoul(texturePath.c_str() + separator + 1, nullptr, 10));
+    }
+
+    VkDeviceSize StreamedTexture::ResidentSize() {
+        // levels being streamed in are counted up front, so concurrent stream-ins can't overshoot the budget
+        uint32_t firstMip = pendingLoad.valid() ? std::min(pendingMip, residentMip) : residentMip;
+        return std::accumulate(levelSizes.begin() + firstMip, levelSizes.end(), VkDeviceSize{0});
+    }
+
+    VulkanTextureManager::VulkanTextureManager(VulkanDevice &device, VulkanAllocator &allocator,
+                                               FileWatcher &fileWatcher)
+        : _device{device}, _allocator{allocator}, _fileWatcher{fileWatcher} {
         CreateImageSampler(_device.Device(), _device.properties.limits.maxSamplerAnisotropy, _defaultSampler);
 
-        // load default image into manager
+        // set once up front, textures are decoded on worker threads
+        stbi_set_flip_vertically_on_load(true);
+
+        // load default image into manager, the manager's own handle keeps it loaded
         LoadTextureImage(DEFAULT_TEXTURE_PATH);
+        _defaultTexture = AcquireTexture(DEFAULT_TEXTURE_PATH);
     }
     VulkanTextureManager::~VulkanTextureManager() {
-        for (const auto &[key, image] : _textures) {
-            AllocatedImage *allocatedImage = image.get();
-            _allocator.DestroyImage(*allocatedImage);
+        _defaultTexture.reset();
+        for (auto &[path, texture] : _textures) {
+            if (texture.pendingLoad.valid()) {
+                texture.pendingLoad.wait();
+            }
+            if (texture.image != nullptr) {
+                _allocator.DestroyImage(*texture.image);
+            }
+            _fileWatcher.Unwatch(path);
         }
         vkDestroySampler(_device.Device(), _defaultSampler, nullptr);
     }
 
-    AllocatedImage *VulkanTextureManager::GetTexture(std::string texturePath) {
-        if (texturePath.empty()) {
-            return _textures[DEFAULT_TEXTURE_PATH].get();
+    TextureHandle VulkanTextureManager::AcquireTexture(const std::string &texturePath) {
+        std::string filePath = TextureFilePath(texturePath);
+        if (filePath.empty()) {
+            return _defaultTexture;
+        }
+
+        // paths that failed to load keep their entry, so they are not decoded again on every acquire
+        if (!_textures.contains(filePath)) {
+            LoadTextureAsync(filePath);
+        }
+
+        StreamedTexture &texture = _textures[filePath];
+        TextureHandle handle = texture.reference.lock();
+        if (handle == nullptr) {
+            handle = TextureHandle(new TextureReference{filePath}, [this](TextureReference *reference) {
+                auto it = _textures.find(reference->path);
+                if (it != _textures.end()) {
+                    it->second.releasedFrame = _frame;
+                }
+                delete reference;
+            });
+            texture.reference = handle;
+        }
+        return handle;
+    }
+
+    AllocatedImage *VulkanTextureManager::GetImage(const TextureHandle &texture) {
+        auto it = _textures.find(texture->path);
+        AllocatedImage *image = it != _textures.end() ? it->second.image.get() : nullptr;
+        return image != nullptr ? image : _textures[DEFAULT_TEXTURE_PATH].image.get();
+    }
+
+    void VulkanTextureManager::RequestResolution(const TextureHandle &handle, float screenSize) {
+        auto it = _textures.find(handle->path);
+        if (it == _textures.end() || it->second.image == nullptr) {
+            return;
+        }
+
+        // one texel per pixel, coarser levels once the texture covers fewer pixels than it has texels
+        StreamedTexture &texture = it->second;
+        float texels = static_cast<float>(std::max(texture.width, texture.height));
+        uint32_t mip = 0;
+        if (screenSize < texels) {
+            mip = static_cast<uint32_t>(std::floor(std::log2(texels / std::max(screenSize, 1.0f))));
+        }
+
+        texture.requestedMip = std::min(texture.requestedMip, mip);
+        texture.lastUsedFrame = _frame;
+    }
+
+    std::vector<std::string> VulkanTextureManager::Update() {
+        std::vector<std::string> changed;
+
+        std::vector<TextureUpload> uploads;
+        for (auto &[path, texture] : _textures) {
+            if (!texture.pendingLoad.valid() ||
+                texture.pendingLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                continue;
+            }
+
+            // keep the current image if the file could not be decoded
+            std::shared_ptr<TextureData> textureData = texture.pendingLoad.get();
+            if (textureData != nullptr) {
+                uploads.push_back({path, textureData, texture.pendingMip});
+            } else if (texture.image == nullptr) {
+                texture.failed = true;
+            }
         }
+        UploadTextures(uploads, changed);
+        UnloadTextures(UNLOAD_DELAY_FRAMES);
 
-        if (!_textures.contains(texturePath)) {
-            if (!LoadTextureImage(texturePath)) {
-                return _textures[DEFAULT_TEXTURE_PATH].get();
+        for (auto &[path, texture] : _textures) {
+            if (texture.image == nullptr || texture.requestedMip >= texture.residentMip ||
+                texture.pendingLoad.valid()) {
+                continue;
             }
+
+            VkDeviceSize size = std::accumulate(texture.levelSizes.begin() + texture.requestedMip,
+                                                texture.levelSizes.begin() + texture.residentMip, VkDeviceSize{0});
+            if (MakeRoom(size, changed)) {
+                StreamTexture(path, texture, texture.requestedMip);
+            }
+        }
+
+        // the budget may have been lowered
+        MakeRoom(0, changed);
+        FlushTransfers();
+
+        for (auto &[path, texture] : _textures) {
+            texture.requestedMip = texture.floorMip;
         }
-        return _textures[texturePath].get();
+        _frame++;
+
+        return changed;
+    }
+
+    void VulkanTextureManager::UnloadUnused() {
+        UnloadTextures(0);
+        FlushTransfers();
+    }
+
+    VkDeviceSize VulkanTextureManager::ResidentMemory() {
+        VkDeviceSize size = 0;
+        for (auto &[path, texture] : _textures) {
+            size += texture.ResidentSize();
+        }
+        return size;
     }
 
+    // Loads a texture synchronously, used for the default texture that has to exist before anything is drawn
     bool VulkanTextureManager::LoadTextureImage(std::string texturePath) {
-        stbi_set_flip_vertically_on_load(true);
-        auto texture = std::make_unique<AllocatedImage>();
+        std::shared_ptr<TextureData> textureData = DecodeTexture(texturePath);
+        if (textureData == nullptr) {
+            return false;
+        }
+
+        std::vector<TextureUpload> uploads = {{texturePath, textureData, UINT32_MAX}};
+        std::vector<std::string> changed;
+        UploadTextures(uploads, changed);
+        FlushTransfers();
+        if (changed.empty()) {
+            return false;
+        }
+
+        _fileWatcher.Watch(texturePath, [this](const std::string &path) { ReloadTexture(path); });
+        return true;
+    }
+
+    // Decodes a texture on the job system. Only the coarse levels are uploaded once it is ready, finer ones stream in
+    // once a material asks for them.
+    void VulkanTextureManager::LoadTextureAsync(const std::string &texturePath) {
+        StreamedTexture &texture = _textures[texturePath];
+        StreamTexture(texturePath, texture, UINT32_MAX);
+
+        // watched right away, so a file that failed to decode is picked up again once it is fixed
+        _fileWatcher.Watch(texturePath, [this](const std::string &path) { ReloadTexture(path); });
+    }
+
+    void VulkanTextureManager::ReloadTexture(const std::string &texturePath) {
+        StreamedTexture &texture = _textures[texturePath];
+        texture.failed = false;
+        uint32_t mip = texture.image != nullptr ? texture.residentMip : UINT32_MAX;
+        if (texture.pendingLoad.valid()) {
+            mip = std::min(mip, texture.pendingMip);
+        }
+        StreamTexture(texturePath, texture, mip);
+    }
+
+    // Reads only mip and coarser where the file allows it, first loads just the streaming floor
+    void VulkanTextureManager::StreamTexture(const std::string &texturePath, StreamedTexture &texture, uint32_t mip) {
+        uint32_t maxLevelSize = STREAMING_FLOOR_SIZE;
+        if (texture.image != nullptr && mip != UINT32_MAX) {
+            maxLevelSize = std::max(std::max(texture.width, texture.height) >> mip, 1u);
+        }
+
+        texture.pendingMip = mip;
+        texture.pendingLoad =
+            JobSystem::Submit([texturePath, maxLevelSize]() { return DecodeTexture(texturePath, maxLevelSize); });
+    }
+
+    // Evicts mips that were not needed last frame, least recently used textures first, until the given size fits
+    // into the budget. Returns false if it does not fit.
+    bool VulkanTextureManager::MakeRoom(VkDeviceSize size, std::vector<std::string> &changed) {
+        VkDeviceSize resident = ResidentMemory();
+        if (resident + size <= _memoryBudget) {
+            return true;
+        }
+
+        std::vector<std::pair<const std::string *, StreamedTexture *>> candidates;
+        for (auto &[path, texture] : _textures) {
+            if (texture.residentMip < texture.requestedMip && !texture.pendingLoad.valid()) {
+                candidates.push_back({&path, &texture});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+            return a.second->lastUsedFrame < b.second->lastUsedFrame;
+        });
+
+        for (auto &[path, texture] : candidates) {
+            uint32_t mip = texture->residentMip;
+            while (mip < texture->requestedMip && resident + size > _memoryBudget) {
+                resident -= texture->levelSizes[mip];
+                mip++;
+            }
+
+            EvictMips(*texture, mip);
+            changed.push_back(*path);
+
+            if (resident + size <= _memoryBudget) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Drops textures whose last handle was released at least unusedFrames ago. Textures still being decoded are
+    // kept until their load has finished. Failed ones hold no gpu memory and are remembered, so acquiring them again
+    // does not decode the broken file again.
+    void VulkanTextureManager::UnloadTextures(uint64_t unusedFrames) {
+        for (auto it = _textures.begin(); it != _textures.end();) {
+            StreamedTexture &texture = it->second;
+            if (!texture.reference.expired() || texture.pendingLoad.valid() || texture.failed ||
+                _frame - texture.releasedFrame < unusedFrames) {
+                ++it;
+                continue;
+            }
+
+            if (texture.image != nullptr) {
+                _retiredImages.push_back(*texture.image);
+            }
+            _fileWatcher.Unwatch(it->first);
+            it = _textures.erase(it);
+        }
+    }
+
+    // Images other than KTX2 files are decoded and downsampled once, then cached as KTX2 files holding the full
+    // chain. Later loads and stream-ins only read the levels they need from the cache.
+    std::shared_ptr<TextureData> VulkanTextureManager::DecodeTexture(const std::string &texturePath,
+                                                                     uint32_t maxLevelSize) {
+        if (std::filesystem::path(texturePath).extension() == ".ktx2") {
+            return DecodeKtx2Texture(texturePath, maxLevelSize);
+        }
+
+        std::filesystem::path cachePath = TextureCachePath(texturePath);
+        if (!cachePath.empty() && std::filesystem::exists(cachePath)) {
+            std::shared_ptr<TextureData> cached = DecodeKtx2Texture(cachePath.string(), maxLevelSize);
+            if (cached != nullptr) {
+                return cached;
+            }
+        }
+
         int texWidth, texHeight, texChannels;
         stbi_uc *pixels = stbi_load(texturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
-        VkExtent3D size = {static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1};
 
         if (!pixels) {
-            IC_CORE_ERROR("Failed to load texture image.");
-            return false;
+            IC_CORE_ERROR("Failed to load texture image {0}.", texturePath);
+            return nullptr;
         }
 
-        AllocatedBuffer stagingBuffer{};
-        _allocator.CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO, stagingBuffer);
+        auto textureData = std::make_shared<TextureData>();
+        textureData->format = TEXTURE_FORMAT;
+        textureData->width = static_cast<uint32_t>(texWidth);
+        textureData->height = static_cast<uint32_t>(texHeight);
 
-        memcpy(stagingBuffer.allocInfo.pMappedData, pixels, static_cast<size_t>(imageSize));
+        VkDeviceSize size = VkDeviceSize(texWidth) * texHeight * 4;
+        textureData->levels.push_back({textureData->width, textureData->height, 0, size});
+        textureData->pixels.assign(pixels, pixels + size);
         stbi_image_free(pixels);
 
-        VkCommandBuffer commandBuffer = _device.BeginSingleTimeCommands();
+        // the full chain is built here so any level can be streamed in
+        while (textureData->levels.back().width > 1 || textureData->levels.back().height > 1) {
+            TextureLevel previous = textureData->levels.back();
+            std::vector<uint8_t> next = DownsampleRGBA8(textureData->pixels.data() + previous.offset, previous.width,
+                                                        previous.height, true);
 
-        _allocator.CreateImage(size, VK_FORMAT_R8G8B8A8_SRGB,
-                               VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, *texture);
-        TransitionImageLayout(commandBuffer, texture->image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
-                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        _device.EndSingleTimeCommands(commandBuffer);
+            textureData->levels.push_back({std::max(1u, previous.width / 2), std::max(1u, previous.height / 2),
+                                           textureData->pixels.size(), next.size()});
+            textureData->pixels.insert(textureData->pixels.end(), next.begin(), next.end());
+        }
 
-        _device.CopyBufferToImage(stagingBuffer.buffer, texture->image, static_cast<uint32_t>(texWidth),
-                                  static_cast<uint32_t>(texHeight), 1);
-        commandBuffer = _device.BeginSingleTimeCommands();
-        TransitionImageLayout(commandBuffer, texture->image, VK_FORMAT_R8G8B8A8_SRGB,
-                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        _device.EndSingleTimeCommands(commandBuffer);
+        if (!cachePath.empty()) {
+            WriteTextureCache(cachePath, *textureData);
+        }
+        return textureData;
+    }
 
-        _allocator.DestroyBuffer(stagingBuffer);
+    // KTX2 files already hold the final gpu format and mip chain, so the levels that were read are copied as is
+    std::shared_ptr<TextureData> VulkanTextureManager::DecodeKtx2Texture(const std::string &texturePath,
+                                                                         uint32_t maxLevelSize) {
+        Ktx2Texture ktx2;
+        if (!ReadKtx2(texturePath, ktx2, maxLevelSize)) {
+            IC_CORE_ERROR("Failed to load texture image {0}.", texturePath);
+            return nullptr;
+        }
 
-        _textures[texturePath] = std::move(texture);
-        return true;
+        auto textureData = std::make_shared<TextureData>();
+        textureData->format = static_cast<VkFormat>(ktx2.vkFormat);
+        textureData->width = ktx2.width;
+        textureData->height = ktx2.height;
+        textureData->layers = ktx2.layers;
+
+        for (const Ktx2Level &level : ktx2.levels) {
+            // skipped levels only count towards the size of the full chain
+            VkDeviceSize size = level.data.size();
+            if (level.data.empty()) {
+                textureData->firstLevel++;
+                size = Ktx2LevelSize(ktx2.vkFormat, level.width, level.height, ktx2.layers);
+            }
+            textureData->levels.push_back({level.width, level.height, textureData->pixels.size(), size});
+            textureData->pixels.insert(textureData->pixels.end(), level.data.begin(), level.data.end());
+        }
+        return textureData;
+    }
+
+    bool VulkanTextureManager::IsFormatSupported(VkFormat format) {
+        bool blockCompressed = format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+        if (blockCompressed && !_device.features.textureCompressionBC) {
+            return false;
+        }
+
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(_device.PhysicalDevice(), format, &formatProperties);
+        return formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    }
+
+    void VulkanTextureManager::CreateTextureImage(VkFormat format, VkExtent3D size, uint32_t mipLevels,
+                                                  uint32_t layers, AllocatedImage &image) {
+        _allocator.CreateImage(size, format,
+                               VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                   VK_IMAGE_USAGE_SAMPLED_BIT,
+                               image, mipLevels, layers);
+
+        // replaced with an array view, single layer textures included
+        vkDestroyImageView(_device.Device(), image.view, nullptr);
+        VkImageViewCreateInfo viewInfo = ImageViewCreateInfo(format, image.image, VK_IMAGE_ASPECT_COLOR_BIT);
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+        viewInfo.subresourceRange.levelCount = mipLevels;
+        viewInfo.subresourceRange.layerCount = layers;
+
+        // single channel masks are broadcast so shaders sampling .rgb read the same value as from an rgba image
+        if (format == VK_FORMAT_BC4_UNORM_BLOCK) {
+            viewInfo.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R,
+                                   VK_COMPONENT_SWIZZLE_ONE};
+        }
+        VK_CHECK(vkCreateImageView(_device.Device(), &viewInfo, nullptr, &image.view));
+    }
+
+    // Creates the gpu images holding levels firstMip and coarser, replacing any image already loaded for the path.
+    // A firstMip past the streaming floor is clamped to it. All uploads share one staging buffer and are recorded
+    // with one barrier batch before and after the copies.
+    void VulkanTextureManager::UploadTextures(std::vector<TextureUpload> &uploads, std::vector<std::string> &changed) {
+        struct PreparedUpload {
+            TextureUpload &upload;
+            uint32_t floorMip;
+            uint32_t firstMip;
+            VkDeviceSize stagingOffset;
+            std::unique_ptr<AllocatedImage> image;
+        };
+
+        std::vector<PreparedUpload> prepared;
+        VkDeviceSize stagingSize = 0;
+        for (TextureUpload &upload : uploads) {
+            TextureData &textureData = *upload.data;
+            if (!IsFormatSupported(textureData.format)) {
+                IC_CORE_ERROR("Texture {0} uses format {1}, which this device cannot sample.", upload.path,
+                              static_cast<uint32_t>(textureData.format));
+                if (_textures[upload.path].image == nullptr) {
+                    _textures[upload.path].failed = true;
+                }
+                continue;
+            }
+
+            uint32_t floorMip = FloorMip(textureData, STREAMING_FLOOR_SIZE);
+            uint32_t firstMip = std::max(std::min(upload.firstMip, floorMip), textureData.firstLevel);
+
+            // offsets must be a multiple of the texel block size, 16 covers every supported format
+            stagingSize = (stagingSize + 15) & ~VkDeviceSize{15};
+            prepared.push_back({upload, floorMip, firstMip, stagingSize});
+
+            const TextureLevel &last = textureData.levels.back();
+            stagingSize += last.offset + last.size - textureData.levels[firstMip].offset;
+        }
+
+        if (prepared.empty()) {
+            return;
+        }
+
+        AllocatedBuffer &stagingBuffer = _stagingBuffers.emplace_back();
+        _allocator.CreateBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO, stagingBuffer);
+
+        std::vector<VkImageMemoryBarrier> transferBarriers;
+        std::vector<VkImageMemoryBarrier> shaderBarriers;
+        for (PreparedUpload &upload : prepared) {
+            TextureData &textureData = *upload.upload.data;
+            const TextureLevel &first = textureData.levels[upload.firstMip];
+            const TextureLevel &last = textureData.levels.back();
+            uint32_t mipLevels = static_cast<uint32_t>(textureData.levels.size()) - upload.firstMip;
+
+            auto *staging = static_cast<unsigned char *>(stagingBuffer.allocInfo.pMappedData) + upload.stagingOffset;
+            memcpy(staging, textureData.pixels.data() + first.offset,
+                   static_cast<size_t>(last.offset + last.size - first.offset));
+
+            upload.image = std::make_unique<AllocatedImage>();
+            CreateTextureImage(textureData.format, {first.width, first.height, 1}, mipLevels, textureData.layers,
+                               *upload.image);
+
+            transferBarriers.push_back(ImageMemoryBarrier(upload.image->image, VK_IMAGE_LAYOUT_UNDEFINED,
+                                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+                                                          VK_ACCESS_TRANSFER_WRITE_BIT, mipLevels));
+            shaderBarriers.push_back(ImageMemoryBarrier(upload.image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                                        mipLevels));
+        }
+
+        VkCommandBuffer commandBuffer = TransferCommands();
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, static_cast<uint32_t>(transferBarriers.size()),
+                             transferBarriers.data());
+
+        for (PreparedUpload &upload : prepared) {
+            TextureData &textureData = *upload.upload.data;
+            VkDeviceSize firstOffset = textureData.levels[upload.firstMip].offset;
+
+            std::vector<VkBufferImageCopy> regions;
+            for (uint32_t level = upload.firstMip; level < textureData.levels.size(); level++) {
+                VkBufferImageCopy &region = regions.emplace_back();
+                region.bufferOffset = upload.stagingOffset + textureData.levels[level].offset - firstOffset;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = level - upload.firstMip;
+                region.imageSubresource.baseArrayLayer = 0;
+                region.imageSubresource.layerCount = textureData.layers;
+                region.imageExtent = {textureData.levels[level].width, textureData.levels[level].height, 1};
+            }
+
+            vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.buffer, upload.image->image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()),
+                                   regions.data());
+        }
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             0, nullptr, 0, nullptr, static_cast<uint32_t>(shaderBarriers.size()),
+                             shaderBarriers.data());
+
+        for (PreparedUpload &upload : prepared) {
+            TextureData &textureData = *upload.upload.data;
+            StreamedTexture &texture = _textures[upload.upload.path];
+            if (texture.image != nullptr) {
+                _retiredImages.push_back(*texture.image);
+            } else {
+                texture.requestedMip = upload.floorMip;
+            }
+
+            texture.image = std::move(upload.image);
+            texture.format = textureData.format;
+            texture.width = textureData.width;
+            texture.height = textureData.height;
+            texture.layers = textureData.layers;
+            texture.levelSizes.clear();
+            for (const TextureLevel &level : textureData.levels) {
+                texture.levelSizes.push_back(level.size);
+            }
+            texture.residentMip = upload.firstMip;
+            texture.floorMip = upload.floorMip;
+
+            changed.push_back(upload.upload.path);
+        }
+    }
+
+    // Drops the levels finer than mip by copying the remaining ones into a smaller image on the gpu
+    void VulkanTextureManager::EvictMips(StreamedTexture &texture, uint32_t mip) {
+        if (mip <= texture.residentMip) {
+            return;
+        }
+
+        uint32_t mipCount = static_cast<uint32_t>(texture.levelSizes.size());
+        uint32_t oldLevels = mipCount - texture.residentMip;
+        uint32_t newLevels = mipCount - mip;
+
+        auto image = std::make_unique<AllocatedImage>();
+        CreateTextureImage(texture.format,
+                           {std::max(1u, texture.width >> mip), std::max(1u, texture.height >> mip), 1}, newLevels,
+                           texture.layers, *image);
+
+        std::vector<VkImageCopy> regions;
+        for (uint32_t level = mip; level < mipCount; level++) {
+            VkImageCopy &region = regions.emplace_back();
+            region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - texture.residentMip, 0, texture.layers};
+            region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - mip, 0, texture.layers};
+            region.extent = {std::max(1u, texture.width >> level), std::max(1u, texture.height >> level), 1};
+        }
+
+        // earlier frames may still be sampling the source, and it may have been uploaded earlier in the same command
+        // buffer, which the barrier that made it shader readable already waits for
+        VkImageMemoryBarrier copyBarriers[] = {
+            ImageMemoryBarrier(texture.image->image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+                               VK_ACCESS_TRANSFER_READ_BIT, oldLevels),
+            ImageMemoryBarrier(image->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+                               VK_ACCESS_TRANSFER_WRITE_BIT, newLevels)};
+        VkImageMemoryBarrier shaderBarrier =
+            ImageMemoryBarrier(image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                               VK_ACCESS_SHADER_READ_BIT, newLevels);
+
+        VkCommandBuffer commandBuffer = TransferCommands();
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, copyBarriers);
+        vkCmdCopyImage(commandBuffer, texture.image->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image->image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &shaderBarrier);
+
+        _retiredImages.push_back(*texture.image);
+        texture.image = std::move(image);
+        texture.residentMip = mip;
+    }
+
+    VkCommandBuffer VulkanTextureManager::TransferCommands() {
+        if (_transferCommands == VK_NULL_HANDLE) {
+            _transferCommands = _device.BeginSingleTimeCommands();
+        }
+        return _transferCommands;
+    }
+
+    // Submits everything recorded this update in one go, then frees the staging memory and replaced or unloaded
+    // images
+    void VulkanTextureManager::FlushTransfers() {
+        if (_transferCommands != VK_NULL_HANDLE) {
+            _device.EndSingleTimeCommands(_transferCommands);
+            _transferCommands = VK_NULL_HANDLE;
+        }
+
+        for (AllocatedBuffer &buffer : _stagingBuffers) {
+            _allocator.DestroyBuffer(buffer);
+        }
+        _stagingBuffers.clear();
+        for (AllocatedImage &image : _retiredImages) {
+            _allocator.DestroyImage(image);
+        }
+        _retiredImages.clear();
     }
-} // namespace IC
\ No newline at end of file
+} // namespace IC
@@ -1,18 +1,103 @@
 #pragma once
 
+#include "ic_file_watcher.h"
 #include "vulkan_allocator.h"
 #include "vulkan_device.h"
 #include "vulkan_types.h"
 
+#include <future>
 #include <map>
 
 namespace IC {
+    struct TextureLevel {
+        uint32_t width;
+        uint32_t height;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    // Texel data of a texture's mip chain, either decoded and downsampled on the cpu or read from a KTX2 file. Each
+    // level holds all layers of the texture one after another. Levels before firstLevel were not read, they only
+    // describe the full chain.
+    struct TextureData {
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t layers = 1;
+        uint32_t firstLevel = 0;
+        std::vector<TextureLevel> levels;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct TextureUpload {
+        std::string path;
+        std::shared_ptr<TextureData> data;
+        uint32_t firstMip;
+    };
+
+    // Texture with a partially resident mip chain. Finer levels are streamed in when materials ask for them and
+    // evicted again under memory pressure, the coarse levels from floorMip down always stay resident.
+    struct StreamedTexture {
+        // nullptr until the first load has been uploaded
+        std::unique_ptr<AllocatedImage> image;
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t layers = 1;
+        // gpu size of every level of the full chain
+        std::vector<VkDeviceSize> levelSizes;
+        // finest level in the image
+        uint32_t residentMip = 0;
+        uint32_t floorMip = 0;
+        // finest level asked for since the last update
+        uint32_t requestedMip = 0;
+        uint64_t lastUsedFrame = 0;
+
+        // handed out by AcquireTexture, the texture is unloaded once this has expired for long enough
+        std::weak_ptr<TextureReference> reference;
+        uint64_t releasedFrame = 0;
+        // the last load failed, it is only retried once the file changes
+        bool failed = false;
+
+        std::future<std::shared_ptr<TextureData>> pendingLoad;
+        uint32_t pendingMip = 0;
+
+        VkDeviceSize ResidentSize();
+    };
+
+    // Materials refer to one layer of a packed texture array as "<file>#<layer>". Only a trailing '#' followed by
+    // digits is a layer, any other path refers to layer 0 of the whole file.
+    std::string TextureFilePath(const std::string &texturePath);
+    uint32_t TextureLayer(const std::string &texturePath);
+
+    // All textures are created as 2D arrays, so shaders sample packed and standalone textures the same way.
     class VulkanTextureManager {
     public:
-        VulkanTextureManager(VulkanDevice &device, VulkanAllocator &allocator);
+        VulkanTextureManager(VulkanDevice &device, VulkanAllocator &allocator, FileWatcher &fileWatcher);
         ~VulkanTextureManager();
 
-        AllocatedImage *GetTexture(std::string texturePath);
+        // Returns a handle keeping the texture file loaded, starting to load it if needed. An empty path refers to
+        // the default texture.
+        TextureHandle AcquireTexture(const std::string &texturePath);
+
+        // Returns the default texture while the texture is still being decoded or failed to load. Its path is
+        // reported by Update() once the real image is available.
+        AllocatedImage *GetImage(const TextureHandle &texture);
+
+        // Reports how many pixels a texture covers on screen this frame, which decides the finest mip to stream in.
+        void RequestResolution(const TextureHandle &handle, float screenSize);
+
+        // Uploads finished loads, reloads and stream-ins, starts new stream-ins and evicts mips to stay within the
+        // memory budget. All transfers are recorded into one command buffer. Returns the paths of textures whose
+        // image changed. Must be called while no frame is in flight, as the old images are destroyed.
+        std::vector<std::string> Update();
+
+        // Unloads every texture without handles right away instead of after the usual delay. Must be called while
+        // no frame is in flight.
+        void UnloadUnused();
+
+        void SetMemoryBudget(VkDeviceSize budget) { _memoryBudget = budget; }
+        VkDeviceSize ResidentMemory();
 
         VkSampler DefaultSampler() { return _defaultSampler; };
 
@@ -20,13 +105,44 @@ namespace IC {
         VulkanTextureManager(const VulkanTextureManager &) = delete;
         void operator=(const VulkanTextureManager &) = delete;
         bool LoadTextureImage(std::string texturePath);
+        void LoadTextureAsync(const std::string &texturePath);
+        void ReloadTexture(const std::string &texturePath);
+        void StreamTexture(const std::string &texturePath, StreamedTexture &texture, uint32_t mip);
+        void UploadTextures(std::vector<TextureUpload> &uploads, std::vector<std::string> &changed);
+        void EvictMips(StreamedTexture &texture, uint32_t mip);
+        bool MakeRoom(VkDeviceSize size, std::vector<std::string> &changed);
+        void UnloadTextures(uint64_t unusedFrames);
+        VkCommandBuffer TransferCommands();
+        void FlushTransfers();
+        void CreateTextureImage(VkFormat format, VkExtent3D size, uint32_t mipLevels, uint32_t layers,
+                                AllocatedImage &image);
+        bool IsFormatSupported(VkFormat format);
+        static std::shared_ptr<TextureData> DecodeTexture(const std::string &texturePath,
+                                                          uint32_t maxLevelSize = UINT32_MAX);
+        static std::shared_ptr<TextureData> DecodeKtx2Texture(const std::string &texturePath, uint32_t maxLevelSize);
 
         const std::string DEFAULT_TEXTURE_PATH = "resources/textures/default_texture.png";
+        static constexpr VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+        // levels up to this size load immediately and are never evicted
+        static constexpr uint32_t STREAMING_FLOOR_SIZE = 64;
+        static constexpr VkDeviceSize DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+        // textures stay loaded for a moment after their last handle is released, so quickly re-acquired ones are
+        // not decoded again
+        static constexpr uint64_t UNLOAD_DELAY_FRAMES = 120;
 
         VulkanAllocator &_allocator;
         VulkanDevice &_device;
+        FileWatcher &_fileWatcher;
 
         VkSampler _defaultSampler;
-        std::unordered_map<std::string, std::unique_ptr<AllocatedImage>> _textures;
+        VkDeviceSize _memoryBudget = DEFAULT_MEMORY_BUDGET;
+        uint64_t _frame = 0;
+        std::unordered_map<std::string, StreamedTexture> _textures;
+        TextureHandle _defaultTexture;
+
+        // transfers recorded this update, submitted together by FlushTransfers
+        VkCommandBuffer _transferCommands = VK_NULL_HANDLE;
+        std::vector<AllocatedBuffer> _stagingBuffers;
+        std::vector<AllocatedImage> _retiredImages;
     };
-} // namespace IC
\ No newline at end of file
+} // namespace IC
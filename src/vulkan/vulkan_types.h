@@ -13,10 +13,16 @@
 #include <glm/vec4.hpp>
 #include <vulkan/vk_enum_string_helper.h>
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
 #include <cstring>
+#include <future>
+#include <map>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 #define VK_CHECK(x)                                                                                                    \
@@ -42,14 +48,29 @@ namespace IC {
         VmaAllocation allocation;
     };
 
+    // updated every frame, shared by every object's draws
     struct CameraDescriptors {
         glm::mat4 proj;
+        glm::mat4 view;
     };
 
-    // size = 128 bytes
-    struct TransformationPushConstants {
+    // Per object data in the object storage buffer, indexed by the instance index. Matches object_data.glsl.
+    // size = 192 bytes
+    struct GpuObjectData {
         glm::mat4 model;
-        glm::mat4 view;
+        // inverse transpose of the model matrix, so shaders don't invert a matrix per vertex. Stored as a mat4 as mat3
+        // columns are padded to vec4 anyway.
+        glm::mat4 normal;
+        // world space bounding sphere, center in xyz and radius in w
+        glm::vec4 sphere;
+        uint32_t indexCount;
+        // draw batch of the object and the first indirect command slot of that batch
+        uint32_t batch;
+        uint32_t firstCommand;
+        // index of the render object, which keeps its visibility across frames
+        uint32_t renderIndex;
+        // array layer sampled by each material texture binding
+        std::array<uint32_t, MAX_MATERIAL_TEXTURES> textureLayers;
     };
 
     struct PointLightData {
@@ -69,28 +90,50 @@ namespace IC {
         alignas(16) glm::vec3 spec;
     };
 
+    // size = 64 bytes
     struct PointLightDescriptors {
         alignas(16) glm::vec3 pos;
+        // distance beyond which the light is ignored
+        glm::float32 range;
         alignas(16) glm::vec3 amb;
-        alignas(16) glm::vec3 diff;
-        alignas(16) glm::vec3 spec;
         glm::float32 cons;
+        alignas(16) glm::vec3 diff;
         glm::float32 lin;
+        alignas(16) glm::vec3 spec;
         glm::float32 quad;
     };
 
+    // point lights are read from the light cluster buffers
     struct SceneLightDescriptors {
         DirectionalLightDescriptors directionalLight;
-        std::array<PointLightDescriptors, MAX_POINT_LIGHTS> pointLights;
-        glm::uint32 numPointLights;
+        alignas(16) glm::uvec3 clusterCounts;
+        // depth slice of a view space depth d is log(d) * sliceScale + sliceBias
+        glm::float32 sliceScale;
+        // size of a cluster on screen in pixels
+        glm::vec2 clusterSize;
+        glm::float32 sliceBias;
     };
 
     struct Pipeline {
-        VkPipeline pipeline;
-        VkPipelineLayout layout;
-        std::vector<VkShaderModule> shaderModules;
+        // VK_NULL_HANDLE until the background compile has finished, or if it failed
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        // depth only variant running the same vertex shader, built along with pipeline for depth prepassed keys
+        VkPipeline depthPipeline = VK_NULL_HANDLE;
+        // groups draws in the render queue
+        uint32_t id = 0;
+        // layouts are shared between pipelines and owned by the PipelineManager. VK_NULL_HANDLE until the shaders
+        // have been reflected, or if they failed to load.
+        VkPipelineLayout layout = VK_NULL_HANDLE;
         std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+        // as declared by the shaders, size 0 if they don't use push constants
+        VkPushConstantRange pushConstants{};
         MaterialFlags materialFlags;
+        std::string vertShaderPath;
+        std::string fragShaderPath;
+        // pipeline and depthPipeline
+        std::future<std::pair<VkPipeline, VkPipeline>> pendingBuild;
+
+        bool IsReady() { return pipeline != VK_NULL_HANDLE; }
 
         bool operator<(const Pipeline &other) const {
             return pipeline < other.pipeline &&
@@ -98,28 +141,72 @@ namespace IC {
         }
     };
 
+    // GPU copy of a mesh asset, shared by every render object that draws the asset
+    struct GpuMesh {
+        std::shared_ptr<MeshAsset> asset;
+        // groups draws in the render queue
+        uint32_t id = 0;
+        uint32_t version = 0;
+        uint32_t indexCount = 0;
+        AllocatedBuffer vertexBuffer{};
+        AllocatedBuffer indexBuffer{};
+    };
+
+    // Keeps a texture loaded in the texture manager while held. The texture is unloaded a few frames after the last
+    // handle is released.
+    struct TextureReference {
+        std::string path;
+    };
+    using TextureHandle = std::shared_ptr<TextureReference>;
+
     struct MeshRenderData {
         Mesh &meshData;
         Transform &transform;
         std::shared_ptr<Pipeline> renderPipeline;
+        // shared by objects whose materials differ at most in texture layers and uniform values, which are drawn next
+        // to each other
+        uint32_t materialId = 0;
+        // drawn in the depth prepass, its pipeline then tests for equal depth
+        bool depthPrepass = false;
         std::vector<std::vector<VkDescriptorSet>> descriptorSets;
-        AllocatedBuffer vertexBuffer;
-        AllocatedBuffer indexBuffer;
+        std::shared_ptr<GpuMesh> gpuMesh;
         std::vector<AllocatedBuffer> mvpBuffers;
-        std::vector<AllocatedBuffer> lightsBuffers;
         std::vector<AllocatedBuffer> materialBuffers;
+        // copied into the object buffer, so objects whose materials differ in layers only can share a batch
+        std::array<uint32_t, MAX_MATERIAL_TEXTURES> textureLayers{};
+        // material textures by binding index
+        std::map<int, TextureHandle> textures;
+
+        // geometry buffers are only created once the mesh has finished loading
+        bool IsResident() { return gpuMesh != nullptr; }
 
         void Bind(VkCommandBuffer cBuffer, VkPipelineLayout pipelineLayout, size_t currentFrame) {
-            VkBuffer vertexBuffers[] = {vertexBuffer.buffer};
+            BindGeometry(cBuffer, gpuMesh->vertexBuffer, gpuMesh->indexBuffer);
+            BindDescriptorSets(cBuffer, pipelineLayout, currentFrame);
+        }
+
+        void BindGeometry(VkCommandBuffer cBuffer, AllocatedBuffer &vertices, AllocatedBuffer &indices) {
+            VkBuffer vertexBuffers[] = {vertices.buffer};
             VkDeviceSize offsets[] = {0};
             vkCmdBindVertexBuffers(cBuffer, 0, 1, vertexBuffers, offsets);
-            vkCmdBindIndexBuffer(cBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(cBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+        }
+
+        // binds the first setCount sets, the fallback pipeline only uses the per object set
+        void BindDescriptorSets(VkCommandBuffer cBuffer, VkPipelineLayout pipelineLayout, size_t currentFrame,
+                                size_t setCount = SIZE_MAX) {
             vkCmdBindDescriptorSets(cBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
-                                    descriptorSets[currentFrame].size(), descriptorSets[currentFrame].data(), 0,
-                                    nullptr);
+                                    std::min(setCount, descriptorSets[currentFrame].size()),
+                                    descriptorSets[currentFrame].data(), 0, nullptr);
         }
 
-        void Draw(VkCommandBuffer cBuffer) { vkCmdDrawIndexed(cBuffer, meshData.IndexCount(), 1, 0, 0, 0); }
+        uint32_t MaterialSetIndex() { return meshData.Material()->Template().flags & MaterialFlags::Lit ? 2 : 1; }
+
+        // draws objectCount instances whose objects are consecutive in the object buffer, the vertex shaders index
+        // objects with gl_InstanceIndex
+        void Draw(VkCommandBuffer cBuffer, uint32_t firstObject, uint32_t objectCount) {
+            vkCmdDrawIndexed(cBuffer, gpuMesh->indexCount, objectCount, 0, 0, firstObject);
+        }
 
         void UpdateMvpBuffer(CameraDescriptors uniformBuffer, uint32_t currentImage) {
             memcpy(mvpBuffers[currentImage].allocInfo.pMappedData, &uniformBuffer, sizeof(uniformBuffer));
@@ -40,7 +40,7 @@ namespace IC {
     }
 
     void TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout,
-                               VkImageLayout newLayout) {
+                               VkImageLayout newLayout, uint32_t mipLevels) {
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         barrier.oldLayout = oldLayout;
@@ -50,7 +50,7 @@ namespace IC {
         barrier.image = image;
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.levelCount = mipLevels;
         barrier.subresourceRange.baseArrayLayer = 0;
         barrier.subresourceRange.layerCount = 1;
         barrier.srcAccessMask = 0;
@@ -83,15 +83,16 @@ namespace IC {
         vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
     }
 
+    VkImageAspectFlags DepthAspectFlags(VkFormat format) {
+        if (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT) {
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    }
+
     // destructors
     void DestroyPipeline(VkDevice device, const Pipeline &pipeline) {
         vkDestroyPipeline(device, pipeline.pipeline, nullptr);
-        vkDestroyPipelineLayout(device, pipeline.layout, nullptr);
-        for (auto layout : pipeline.descriptorSetLayouts) {
-            vkDestroyDescriptorSetLayout(device, layout, nullptr);
-        }
-        for (auto shader : pipeline.shaderModules) {
-            vkDestroyShaderModule(device, shader, nullptr);
-        }
+        vkDestroyPipeline(device, pipeline.depthPipeline, nullptr);
     }
 } // namespace IC
@@ -7,7 +7,9 @@ namespace IC {
     void CopyImageToImage(VkCommandBuffer commandBuffer, VkImage source, VkImage destination, VkExtent2D srcSize,
                           VkExtent2D dstSize);
     void TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout,
-                               VkImageLayout newLayout);
+                               VkImageLayout newLayout, uint32_t mipLevels = 1);
+    // aspects barriers on an image of a depth format have to cover
+    VkImageAspectFlags DepthAspectFlags(VkFormat format);
     // destructors
     void DestroyPipeline(VkDevice device, const Pipeline &pipeline);
 } // namespace IC
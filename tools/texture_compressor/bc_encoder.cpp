@@ -0,0 +1,269 @@
+#include "bc_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace IC {
+    namespace {
+        constexpr uint32_t BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        struct BitWriter {
+            uint8_t *data;
+            uint32_t position = 0;
+
+            void Write(uint32_t value, uint32_t bitCount) {
+                for (uint32_t bit = 0; bit < bitCount; bit++, position++) {
+                    if ((value >> bit) & 1) {
+                        data[position / 8] |= static_cast<uint8_t>(1 << (position % 8));
+                    }
+                }
+            }
+        };
+
+        int ColorDistance(const int *a, const uint8_t *b, int channels) {
+            int distance = 0;
+            for (int c = 0; c < channels; c++) {
+                int delta = a[c] - b[c];
+                distance += delta * delta;
+            }
+            return distance;
+        }
+
+        // Fits a line through the block's texels along their principal axis and returns its two ends.
+        void FitEndpoints(const uint8_t *texels, int channels, float start[4], float end[4]) {
+            float mean[4] = {};
+            for (int i = 0; i < 16; i++) {
+                for (int c = 0; c < channels; c++) {
+                    mean[c] += texels[i * 4 + c] / 16.0f;
+                }
+            }
+
+            float covariance[4][4] = {};
+            for (int i = 0; i < 16; i++) {
+                for (int a = 0; a < channels; a++) {
+                    for (int b = 0; b < channels; b++) {
+                        covariance[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+                    }
+                }
+            }
+
+            // a few rounds of power iteration are plenty for a 4x4 matrix
+            float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+            for (int iteration = 0; iteration < 8; iteration++) {
+                float next[4] = {};
+                float largest = 0.0f;
+                for (int a = 0; a < channels; a++) {
+                    for (int b = 0; b < channels; b++) {
+                        next[a] += covariance[a][b] * axis[b];
+                    }
+                    largest = std::max(largest, std::abs(next[a]));
+                }
+                if (largest < 1e-6f) {
+                    break;
+                }
+                for (int c = 0; c < channels; c++) {
+                    axis[c] = next[c] / largest;
+                }
+            }
+
+            float minProjection = std::numeric_limits<float>::max();
+            float maxProjection = std::numeric_limits<float>::lowest();
+            float axisLength = 0.0f;
+            for (int c = 0; c < channels; c++) {
+                axisLength += axis[c] * axis[c];
+            }
+            for (int i = 0; i < 16; i++) {
+                float projection = 0.0f;
+                for (int c = 0; c < channels; c++) {
+                    projection += (texels[i * 4 + c] - mean[c]) * axis[c];
+                }
+                minProjection = std::min(minProjection, projection / axisLength);
+                maxProjection = std::max(maxProjection, projection / axisLength);
+            }
+
+            for (int c = 0; c < channels; c++) {
+                start[c] = std::clamp(mean[c] + axis[c] * maxProjection, 0.0f, 255.0f);
+                end[c] = std::clamp(mean[c] + axis[c] * minProjection, 0.0f, 255.0f);
+            }
+        }
+
+        uint16_t To565(const float color[3]) {
+            uint16_t r = static_cast<uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+            uint16_t g = static_cast<uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+            uint16_t b = static_cast<uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        void From565(uint16_t value, int color[3]) {
+            int r = (value >> 11) & 31;
+            int g = (value >> 5) & 63;
+            int b = value & 31;
+            color[0] = (r << 3) | (r >> 2);
+            color[1] = (g << 2) | (g >> 4);
+            color[2] = (b << 3) | (b >> 2);
+        }
+
+        void EncodeBC4Channel(const uint8_t *texels, int channel, uint8_t *block) {
+            memset(block, 0, 8);
+
+            uint8_t minValue = 255;
+            uint8_t maxValue = 0;
+            for (int i = 0; i < 16; i++) {
+                minValue = std::min(minValue, texels[i * 4 + channel]);
+                maxValue = std::max(maxValue, texels[i * 4 + channel]);
+            }
+
+            block[0] = maxValue;
+            block[1] = minValue;
+            if (maxValue == minValue) {
+                return;
+            }
+
+            // max > min selects the eight value palette
+            int palette[8] = {maxValue, minValue};
+            for (int i = 2; i < 8; i++) {
+                palette[i] = ((8 - i) * maxValue + (i - 1) * minValue + 3) / 7;
+            }
+
+            uint64_t indices = 0;
+            for (int i = 0; i < 16; i++) {
+                int best = 0;
+                int bestDistance = std::numeric_limits<int>::max();
+                for (int p = 0; p < 8; p++) {
+                    int distance = std::abs(palette[p] - texels[i * 4 + channel]);
+                    if (distance < bestDistance) {
+                        best = p;
+                        bestDistance = distance;
+                    }
+                }
+                indices |= static_cast<uint64_t>(best) << (3 * i);
+            }
+
+            for (int i = 0; i < 6; i++) {
+                block[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+            }
+        }
+
+        // Picks the 7 bit endpoint and p-bit whose 8 bit expansion is closest to the color.
+        void QuantizeBC7Endpoint(const float color[4], uint32_t quantized[4], uint32_t &pBit) {
+            float bestError = std::numeric_limits<float>::max();
+            for (uint32_t p = 0; p < 2; p++) {
+                uint32_t candidate[4];
+                float error = 0.0f;
+                for (int c = 0; c < 4; c++) {
+                    candidate[c] = static_cast<uint32_t>(std::clamp(std::lround((color[c] - p) / 2.0f), 0L, 127L));
+                    float delta = static_cast<float>((candidate[c] << 1) | p) - color[c];
+                    error += delta * delta;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    pBit = p;
+                    std::copy(candidate, candidate + 4, quantized);
+                }
+            }
+        }
+    } // namespace
+
+    void EncodeBC1Block(const uint8_t texels[16 * 4], uint8_t *block) {
+        float start[4], end[4];
+        FitEndpoints(texels, 3, start, end);
+
+        uint16_t color0 = To565(start);
+        uint16_t color1 = To565(end);
+        // color0 > color1 selects the four color mode without transparency
+        if (color0 < color1) {
+            std::swap(color0, color1);
+        }
+
+        uint32_t indices = 0;
+        if (color0 != color1) {
+            int palette[4][3];
+            From565(color0, palette[0]);
+            From565(color1, palette[1]);
+            for (int c = 0; c < 3; c++) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+            }
+
+            for (int i = 0; i < 16; i++) {
+                uint32_t best = 0;
+                int bestDistance = std::numeric_limits<int>::max();
+                for (uint32_t p = 0; p < 4; p++) {
+                    int distance = ColorDistance(palette[p], texels + i * 4, 3);
+                    if (distance < bestDistance) {
+                        best = p;
+                        bestDistance = distance;
+                    }
+                }
+                indices |= best << (2 * i);
+            }
+        }
+
+        memcpy(block, &color0, 2);
+        memcpy(block + 2, &color1, 2);
+        memcpy(block + 4, &indices, 4);
+    }
+
+    void EncodeBC4Block(const uint8_t texels[16 * 4], uint8_t *block) { EncodeBC4Channel(texels, 0, block); }
+
+    void EncodeBC5Block(const uint8_t texels[16 * 4], uint8_t *block) {
+        EncodeBC4Channel(texels, 0, block);
+        EncodeBC4Channel(texels, 1, block + 8);
+    }
+
+    void EncodeBC7Block(const uint8_t texels[16 * 4], uint8_t *block) {
+        float start[4], end[4];
+        FitEndpoints(texels, 4, start, end);
+
+        uint32_t endpoints[2][4];
+        uint32_t pBits[2];
+        QuantizeBC7Endpoint(start, endpoints[0], pBits[0]);
+        QuantizeBC7Endpoint(end, endpoints[1], pBits[1]);
+
+        int palette[16][4];
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 4; c++) {
+                uint32_t e0 = (endpoints[0][c] << 1) | pBits[0];
+                uint32_t e1 = (endpoints[1][c] << 1) | pBits[1];
+                palette[i][c] = static_cast<int>(((64 - BC7_WEIGHTS[i]) * e0 + BC7_WEIGHTS[i] * e1 + 32) >> 6);
+            }
+        }
+
+        uint32_t indices[16];
+        for (int i = 0; i < 16; i++) {
+            int bestDistance = std::numeric_limits<int>::max();
+            for (uint32_t p = 0; p < 16; p++) {
+                int distance = ColorDistance(palette[p], texels + i * 4, 4);
+                if (distance < bestDistance) {
+                    indices[i] = p;
+                    bestDistance = distance;
+                }
+            }
+        }
+
+        // the anchor texel's index is stored without its top bit, so it has to land in the lower half
+        if (indices[0] & 8) {
+            std::swap(endpoints[0], endpoints[1]);
+            std::swap(pBits[0], pBits[1]);
+            for (uint32_t &index : indices) {
+                index = 15 - index;
+            }
+        }
+
+        memset(block, 0, 16);
+        BitWriter writer{block};
+        writer.Write(1 << 6, 7);
+        for (int c = 0; c < 4; c++) {
+            writer.Write(endpoints[0][c], 7);
+            writer.Write(endpoints[1][c], 7);
+        }
+        writer.Write(pBits[0], 1);
+        writer.Write(pBits[1], 1);
+        writer.Write(indices[0], 3);
+        for (int i = 1; i < 16; i++) {
+            writer.Write(indices[i], 4);
+        }
+    }
+} // namespace IC
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+namespace IC {
+    // Block encoders for one 4x4 block of RGBA8 texels, stored row by row. The output is written to block,
+    // which must hold 8 bytes for BC1 and BC4 and 16 bytes for BC5 and BC7.
+    void EncodeBC1Block(const uint8_t texels[16 * 4], uint8_t *block);
+    // Encodes the red channel only.
+    void EncodeBC4Block(const uint8_t texels[16 * 4], uint8_t *block);
+    // Encodes the red and green channels, the usual layout for tangent space normal maps.
+    void EncodeBC5Block(const uint8_t texels[16 * 4], uint8_t *block);
+    // Uses mode 6 only (single subset, RGBA endpoints with 4 bit indices).
+    void EncodeBC7Block(const uint8_t texels[16 * 4], uint8_t *block);
+} // namespace IC
@@ -0,0 +1,203 @@
+#include "bc_encoder.h"
+#include "ic_image.h"
+#include "ic_ktx2.h"
+
+#include <ic_log.h>
+
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace IC;
+
+namespace {
+    struct Options {
+        std::vector<std::string> inputs;
+        std::string output;
+        std::string format = "bc7";
+        bool linear = false;
+        bool mipmaps = true;
+        bool pack = false;
+    };
+
+    struct Image {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> pixels;
+    };
+
+    using BlockEncoder = void (*)(const uint8_t *, uint8_t *);
+
+    void PrintUsage() {
+        IC_APP_INFO("Usage: ICTextureCompressor <input> <output.ktx2> [--format bc7|bc1|bc4|bc5|rgba8] [--linear] "
+                    "[--no-mips]");
+        IC_APP_INFO("       ICTextureCompressor --pack <input>... <output.ktx2> [options]");
+        IC_APP_INFO("  bc7    color textures with alpha (default)");
+        IC_APP_INFO("  bc1    opaque color textures at half the size of bc7");
+        IC_APP_INFO("  bc4    single channel masks such as specular maps, stored from the red channel");
+        IC_APP_INFO("  bc5    normal maps, stores the red and green channels");
+        IC_APP_INFO("  rgba8  uncompressed, for devices without BC support");
+        IC_APP_INFO("  --linear stores color data without the sRGB transfer function");
+        IC_APP_INFO("  --pack   packs same sized textures into the layers of one texture array, materials refer to a "
+                    "layer as <output.ktx2>#<layer>");
+    }
+
+    std::vector<uint8_t> EncodeImage(const Image &image, BlockEncoder encoder, uint32_t blockSize) {
+        if (encoder == nullptr) {
+            return image.pixels;
+        }
+
+        uint32_t blocksX = (image.width + 3) / 4;
+        uint32_t blocksY = (image.height + 3) / 4;
+        std::vector<uint8_t> data(blocksX * blocksY * blockSize);
+
+        uint8_t texels[16 * 4];
+        for (uint32_t by = 0; by < blocksY; by++) {
+            for (uint32_t bx = 0; bx < blocksX; bx++) {
+                // blocks hanging over the edge of small mips repeat the last row and column
+                for (uint32_t i = 0; i < 16; i++) {
+                    uint32_t x = std::min(bx * 4 + i % 4, image.width - 1);
+                    uint32_t y = std::min(by * 4 + i / 4, image.height - 1);
+                    memcpy(texels + i * 4, image.pixels.data() + (y * image.width + x) * 4, 4);
+                }
+                encoder(texels, data.data() + (by * blocksX + bx) * blockSize);
+            }
+        }
+
+        return data;
+    }
+
+    bool ParseOptions(int argc, char **argv, Options &options) {
+        std::vector<std::string> positional;
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            if (argument == "--format" && i + 1 < argc) {
+                options.format = argv[++i];
+            } else if (argument == "--linear") {
+                options.linear = true;
+            } else if (argument == "--no-mips") {
+                options.mipmaps = false;
+            } else if (argument == "--pack") {
+                options.pack = true;
+            } else if (argument.starts_with("--")) {
+                IC_APP_ERROR("Unknown option {0}.", argument);
+                return false;
+            } else {
+                positional.push_back(argument);
+            }
+        }
+
+        if (positional.size() < 2 || (!options.pack && positional.size() != 2)) {
+            return false;
+        }
+        options.output = positional.back();
+        positional.pop_back();
+        options.inputs = positional;
+        return true;
+    }
+
+    bool LoadImage(const std::string &path, Image &image) {
+        int width, height, channels;
+        stbi_uc *pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels) {
+            IC_APP_ERROR("Failed to load image {0}.", path);
+            return false;
+        }
+
+        image = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+        image.pixels.assign(pixels, pixels + width * height * 4);
+        stbi_image_free(pixels);
+        return true;
+    }
+} // namespace
+
+int main(int argc, char **argv) {
+    Log::Init();
+
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    Ktx2Texture texture{};
+    BlockEncoder encoder = nullptr;
+    // bc4 and bc5 hold data rather than color, so they are never sRGB
+    bool srgb = !options.linear;
+    if (options.format == "bc7") {
+        encoder = EncodeBC7Block;
+        texture.vkFormat = static_cast<uint32_t>(srgb ? Ktx2Format::BC7Srgb : Ktx2Format::BC7Unorm);
+    } else if (options.format == "bc1") {
+        encoder = EncodeBC1Block;
+        texture.vkFormat = static_cast<uint32_t>(srgb ? Ktx2Format::BC1RGBSrgb : Ktx2Format::BC1RGBUnorm);
+    } else if (options.format == "bc4") {
+        encoder = EncodeBC4Block;
+        srgb = false;
+        texture.vkFormat = static_cast<uint32_t>(Ktx2Format::BC4Unorm);
+    } else if (options.format == "bc5") {
+        encoder = EncodeBC5Block;
+        srgb = false;
+        texture.vkFormat = static_cast<uint32_t>(Ktx2Format::BC5Unorm);
+    } else if (options.format == "rgba8") {
+        texture.vkFormat = static_cast<uint32_t>(srgb ? Ktx2Format::RGBA8Srgb : Ktx2Format::RGBA8Unorm);
+    } else {
+        IC_APP_ERROR("Unknown format {0}.", options.format);
+        PrintUsage();
+        return 1;
+    }
+
+    // the engine flips images on load, so the stored rows must already be flipped to match
+    stbi_set_flip_vertically_on_load(true);
+    // one image per array layer, all layers share the size of the first
+    std::vector<Image> images(options.inputs.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        if (!LoadImage(options.inputs[i], images[i])) {
+            return 1;
+        }
+        if (images[i].width != images[0].width || images[i].height != images[0].height) {
+            IC_APP_ERROR("{0} is {1}x{2}, but packed textures must all be {3}x{4}.", options.inputs[i],
+                         images[i].width, images[i].height, images[0].width, images[0].height);
+            return 1;
+        }
+    }
+
+    texture.width = images[0].width;
+    texture.height = images[0].height;
+    texture.layers = static_cast<uint32_t>(images.size());
+
+    uint32_t blockSize = Ktx2BlockSize(texture.vkFormat);
+    while (true) {
+        Ktx2Level &level = texture.levels.emplace_back(Ktx2Level{images[0].width, images[0].height});
+        for (const Image &image : images) {
+            std::vector<uint8_t> data = EncodeImage(image, encoder, blockSize);
+            level.data.insert(level.data.end(), data.begin(), data.end());
+        }
+        if (!options.mipmaps || (level.width == 1 && level.height == 1)) {
+            break;
+        }
+        for (Image &image : images) {
+            image.pixels = DownsampleRGBA8(image.pixels.data(), image.width, image.height, srgb);
+            image.width = std::max(1u, image.width / 2);
+            image.height = std::max(1u, image.height / 2);
+        }
+    }
+
+    if (!WriteKtx2(options.output, texture)) {
+        IC_APP_ERROR("Failed to write {0}.", options.output);
+        return 1;
+    }
+
+    IC_APP_INFO("Wrote {0} ({1}x{2}, {3} mip levels, {4}).", options.output, texture.width, texture.height,
+                texture.levels.size(), options.format);
+    if (options.pack) {
+        for (size_t i = 0; i < options.inputs.size(); i++) {
+            IC_APP_INFO("  {0} -> {1}#{2}", options.inputs[i], options.output, i);
+        }
+    }
+    return 0;
+}